@@ -2,97 +2,189 @@
 
 // STL
 #include <atomic>
-#include <list>
+#include <vector>
 
 // PUT
 #include <put/cxxutils/vterm.h>
+#include <put/specialized/osdetect.h>
+
+#if defined(__linux__) && KERNEL_VERSION_CODE >= KERNEL_VERSION(2,6,27) /* Linux 2.6.27+ */
+# include <sys/eventfd.h>
+# define EVENTFD_STEPPER
+#endif
 
 // atomic vars are to avoid race conditions
 static std::atomic_int  s_return_value(0);
 static std::atomic_bool s_run(true); // quit signal
 
-posix::lockable<std::queue<vfunc>> Application::ms_signal_queue;
-
-static posix::fd_t s_pipeio[2] = { posix::invalid_descriptor }; //  execution stepper pipe
+Application::loop_t* Application::ms_loops = nullptr;
+uint16_t Application::ms_loop_count = 0;
+thread_local uint16_t Application::ms_affinity = 0;
 
 enum {
   Read = 0,
   Write = 1,
 };
 
-Application::Application(void) noexcept
+Application::Application(uint16_t loop_count) noexcept
 {
-  if(s_pipeio[Read] == posix::invalid_descriptor) // if execution stepper pipe  hasn't been initialized yet
+  if(ms_loops == nullptr) // if event loops haven't been initialized yet
   {
-    flaw(!posix::pipe(s_pipeio),
-         terminal::critical,
-         posix::exit(errno),,
-         "Unable to create pipe for execution stepper: %s", posix::strerror(errno))
+#if defined(SINGLE_THREADED_APPLICATION)
+    if(loop_count > 1)
+    {
+      posix::fprintf(stderr, "%s%s\n", terminal::warning, "Multiple event loops are unavailable in a single threaded application!");
+      loop_count = 1;
+    }
+#endif
+    if(!loop_count)
+      loop_count = 1;
 
-    posix::fcntl(s_pipeio[Read ], F_SETFD, FD_CLOEXEC); // close on exec*()
-    posix::fcntl(s_pipeio[Write], F_SETFD, FD_CLOEXEC); // close on exec*()
-    posix::donotblock(s_pipeio[Read]); // don't block
+    ms_loops = new loop_t[loop_count];
+    ms_loop_count = loop_count;
 
-    flaw(!EventBackend::add(s_pipeio[Read], EventBackend::SimplePollReadFlags, read),
-         terminal::critical,
-         posix::exit(errno),, // watch for when execution stepper pipe has been triggered
-         "Unable to watch execution stepper to backend: %s", posix::strerror(errno))
+    for(uint16_t id = 0; id < ms_loop_count; ++id)
+    {
+      loop_t& loop = ms_loops[id];
+      loop.executing = false;
+      loop.wakeup_pending = false;
+      loop.wakeups_suppressed = 0;
+      loop.backend = id ? new EventBackend::instance_t : &EventBackend::current(); // first loop uses the default backend
+
+#if defined(EVENTFD_STEPPER)
+      loop.stepper[Read] = loop.stepper[Write] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC); // same FD for both ends
+      flaw(loop.stepper[Read] == posix::invalid_descriptor,
+           terminal::critical,
+           posix::exit(errno),,
+           "Unable to create eventfd for execution stepper: %s", posix::strerror(errno))
+#else
+      flaw(!posix::pipe(loop.stepper),
+           terminal::critical,
+           posix::exit(errno),,
+           "Unable to create pipe for execution stepper: %s", posix::strerror(errno))
+
+      posix::fcntl(loop.stepper[Read ], F_SETFD, FD_CLOEXEC); // close on exec*()
+      posix::fcntl(loop.stepper[Write], F_SETFD, FD_CLOEXEC); // close on exec*()
+      posix::donotblock(loop.stepper[Read]); // don't block
+#endif
+
+      flaw(!loop.backend->add(loop.stepper[Read], EventBackend::SimplePollReadFlags,
+                              [&loop](posix::fd_t fd, native_flags_t) noexcept { read(loop, fd); }),
+           terminal::critical,
+           posix::exit(errno),, // watch for when execution stepper pipe has been triggered
+           "Unable to watch execution stepper to backend: %s", posix::strerror(errno))
+    }
+  }
+}
+
+void Application::setAffinity(uint16_t loop) noexcept
+{
+  if(loop < ms_loop_count)
+  {
+    ms_affinity = loop;
+    EventBackend::setCurrent(loop ? ms_loops[loop].backend : nullptr); // first loop uses the default backend
   }
 }
 
-void Application::step(void) noexcept
+uint64_t Application::suppressedWakeups(uint16_t loop) noexcept
+{
+  return loop < ms_loop_count
+      ? ms_loops[loop].wakeups_suppressed.load(std::memory_order_relaxed)
+      : 0;
+}
+
+bool Application::queued(loop_t& loop, posix::ssize_t count) noexcept
 {
+  if(count == posix::error_response)
+    return false;
+  if(!count) // only the first value queued needs to inform the execution stepper
+    step(loop);
+  else
+    loop.wakeups_suppressed.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void Application::step(loop_t& loop) noexcept
+{
+  if(loop.wakeup_pending.exchange(true)) // if the execution stepper has already been triggered
+  {
+    loop.wakeups_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+#if defined(EVENTFD_STEPPER)
+  static const uint64_t increment = 1;
+  flaw(posix::write(loop.stepper[Write], &increment, sizeof(increment)) != sizeof(increment),
+#else
   static const uint8_t dummydata = 0; // dummy content
-  flaw(posix::write(s_pipeio[Write], &dummydata, 1) != 1,
+  flaw(posix::write(loop.stepper[Write], &dummydata, 1) != 1,
+#endif
        terminal::critical,
        posix::exit(errno),, // triggers execution stepper FD
        "Unable to trigger Object signal queue processor: %s", posix::strerror(errno))
 }
 
 // this is the callback function for the signal queue
-void Application::read(posix::fd_t fd, native_flags_t) noexcept
+void Application::read(loop_t& loop, posix::fd_t fd) noexcept
 {
+  loop.wakeup_pending = false; // must happen before the signal queue is checked
+
   uint64_t discard;
+#if defined(EVENTFD_STEPPER)
+  posix::read(fd, &discard, sizeof(discard)); // reset eventfd counter
+#else
   while(posix::read(fd, &discard, sizeof(discard)) != posix::error_response);
+#endif
 
   // execute queue of object signal calls
-  static std::queue<vfunc> exec_queue;
-  if(exec_queue.empty()) // if not currently executing (recursive or multithread exec() calls?)
+  if(!loop.executing) // if not currently executing (recursive exec() calls?)
   {
-    ms_signal_queue.lock(); // get exclusive access (make thread-safe)
-    exec_queue.swap(ms_signal_queue); // swap the queues
-    ms_signal_queue.unlock(); // access is no longer needed
-
-    while(!exec_queue.empty()) // while still have object signals to execute
-    {
-      exec_queue.front()(); // execute current object signal/callback
-      exec_queue.pop(); // discard current object signal
-    }
+    loop.executing = true;
+    if(loop.signal_queue.consume([](task_t& task) noexcept { task(); })) // execute object signals/callbacks
+      step(loop); // signals were queued without informing the execution stepper
+    loop.executing = false;
   }
 }
 
 void Application::processQueue(void) noexcept
 {
-  EventBackend::poll(); // get event queue results
+  EventBackend::instance_t& backend = EventBackend::current();
+  if(backend.poll()) // get event queue results
+    backend.dispatch(); // invoke the callback functions with the FD and triggering flags
+}
 
-  for(std::pair<posix::fd_t, native_flags_t>& pair : EventBackend::results) // process results
-  {
-    EventBackend::queue.lock(); // get exclusive access (make thread-safe)
-    auto entries = EventBackend::queue.equal_range(pair.first); // get all the entries for that FD
-    std::list<std::pair<posix::fd_t, EventBackend::callback_info_t>> exec_fds(entries.first, entries.second); // copy entries
-    EventBackend::queue.unlock(); // access is no longer needed
-
-    for(std::pair<posix::fd_t, EventBackend::callback_info_t>& entry : exec_fds) // for each FD
-      if(entry.second.flags & pair.second) // check if there is a matching flag
-        entry.second.function(pair.first, pair.second); // invoke the callback function with the FD and triggering Flag
-  }
+void* Application::run(void* loop) noexcept
+{
+  setAffinity(uint16_t(reinterpret_cast<uintptr_t>(loop))); // bind this thread to it's event loop
+  while(s_run) // while not quitting
+    processQueue();
+  return nullptr;
 }
 
 int Application::exec(void) noexcept // non-static function to ensure an instance of Application exists
 {
   s_run = true;
-  while(s_run) // while not quitting
-    processQueue();
+  setAffinity(0); // the calling thread runs the first event loop
+
+#if !defined(SINGLE_THREADED_APPLICATION)
+  std::vector<pthread_t> threads(ms_loop_count);
+  for(uint16_t id = 1; id < ms_loop_count; ++id) // start a thread for every other event loop
+  {
+    posix::error_t err = ::pthread_create(&threads[id], NULL, run, reinterpret_cast<void*>(uintptr_t(id)));
+    flaw(err != posix::success_response,
+         terminal::critical,
+         posix::exit(err),
+         posix::error_response,
+         "Unable to start thread for event loop %u: %s", id, posix::strerror(err))
+  }
+#endif
+
+  run(nullptr);
+
+#if !defined(SINGLE_THREADED_APPLICATION)
+  for(uint16_t id = 1; id < ms_loop_count; ++id) // wait for every other event loop to finish
+    ::pthread_join(threads[id], NULL);
+#endif
   return s_return_value; // quit() has been called, return value specified
 }
 
@@ -102,5 +194,7 @@ void Application::quit(int return_value) noexcept // soft application exit (allo
   {
     s_return_value = return_value; // set application return value
     s_run = false; // indicate program must quit
+    for(uint16_t id = 0; id < ms_loop_count; ++id) // wake every event loop so it can exit
+      step(ms_loops[id]);
   }
 }
@@ -2,11 +2,13 @@
 #define APPLICATION_H
 
 // STL
-#include <queue>
+#include <atomic>
 #include <functional>
 
 // PUT
 #include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/mpscqueue.h>
+#include <put/cxxutils/task.h>
 #include <put/specialized/mutex.h>
 #include <put/specialized/eventbackend.h>
 
@@ -16,16 +18,42 @@ using vfunc = std::function<void()>;
 class Application
 {
 public:
-  Application(void) noexcept;
+  Application(uint16_t loop_count = 1) noexcept; // number of event loops (each gets its own thread)
 
   int exec(void) noexcept;
   static void processQueue(void) noexcept;
   static void quit(int return_value = posix::success_response) noexcept;
 
+  static uint16_t loopCount(void) noexcept { return ms_loop_count; }
+  static uint16_t affinity(void) noexcept { return ms_affinity; } // event loop of the calling thread
+  static void setAffinity(uint16_t loop) noexcept; // event loop that new Objects and FDs of the calling thread are assigned to
+  static uint64_t suppressedWakeups(uint16_t loop = 0) noexcept; // number of times the execution stepper didn't need triggering
+
 private:
-  static void step(void) noexcept;
-  static void read(posix::fd_t fd, native_flags_t) noexcept;
-  static posix::lockable<std::queue<vfunc>> ms_signal_queue;
+  struct loop_t
+  {
+    mpscqueue<task_t> signal_queue; // lock-free and allocation-free for small tasks
+    bool executing; // currently executing signal queue
+    EventBackend::instance_t* backend;
+    posix::fd_t stepper[2]; // execution stepper (eventfd or pipe)
+    std::atomic_bool wakeup_pending; // execution stepper has been triggered
+    std::atomic<uint64_t> wakeups_suppressed;
+  };
+
+  template<typename Func>
+  static bool enqueue(uint16_t loop, Func&& function) noexcept // thread-safe
+  {
+    return loop < ms_loop_count && // if a valid event loop
+           queued(ms_loops[loop], ms_loops[loop].signal_queue.emplace(std::forward<Func>(function)));
+  }
+
+  static bool queued(loop_t& loop, posix::ssize_t count) noexcept; // inform execution stepper (if needed)
+  static void step(loop_t& loop) noexcept;
+  static void read(loop_t& loop, posix::fd_t fd) noexcept;
+  static void* run(void* loop) noexcept; // worker thread entry point
+  static loop_t* ms_loops;
+  static uint16_t ms_loop_count;
+  static thread_local uint16_t ms_affinity;
   friend class Object;
 };
 
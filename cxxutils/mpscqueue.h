@@ -0,0 +1,168 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+// STL
+#include <atomic>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+
+#if !defined(MPSC_NODE_BLOCK)
+#define MPSC_NODE_BLOCK 64 // number of nodes allocated at once
+#endif
+
+// lock-free multiple producer, single consumer queue (intrusive linked list with recycled nodes)
+template<typename T>
+class mpscqueue
+{
+  struct node_t
+  {
+    std::atomic<node_t*> next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    T& value(void) noexcept { return *reinterpret_cast<T*>(&storage); }
+  };
+
+  struct cache_t // nodes reserved for the current thread
+  {
+    node_t* head = nullptr;
+    ~cache_t(void) noexcept // give reserved nodes to other threads
+    {
+      if(head != nullptr)
+      {
+        node_t* last = head;
+        while(last->next.load(std::memory_order_relaxed) != nullptr)
+          last = last->next.load(std::memory_order_relaxed);
+        release(head, last);
+      }
+    }
+  };
+
+public:
+  mpscqueue(void) noexcept
+    : m_head(&m_stub), m_tail(&m_stub), m_count(0)
+    { m_stub.next.store(nullptr, std::memory_order_relaxed); }
+
+  ~mpscqueue(void) noexcept
+    { consume([](T&) noexcept { }); } // destroy remaining values
+
+  mpscqueue(const mpscqueue& other) = delete;
+  mpscqueue& operator=(const mpscqueue& other) = delete;
+
+  bool empty(void) const noexcept { return !m_count.load(std::memory_order_acquire); }
+
+  // any thread: returns the number of values that were queued (0 means the consumer must be woken) or error_response
+  template<typename... ArgTypes>
+  posix::ssize_t emplace(ArgTypes&&... args) noexcept
+  {
+    node_t* node = acquire();
+    if(node == nullptr) // out of memory
+      return posix::error_response;
+
+    new (&node->storage) T(std::forward<ArgTypes>(args)...);
+    node->next.store(nullptr, std::memory_order_relaxed);
+    push(node);
+    return posix::ssize_t(m_count.fetch_add(1)); // sequentially consistent so wakeup flags can be ordered against it
+  }
+
+  // consumer thread only: calls function with every value queued before the call (in order)
+  // returns true if values remain (they were queued without waking the consumer)
+  template<typename Func>
+  bool consume(Func function) noexcept
+  {
+    posix::size_t limit = m_count.load(); // values queued while consuming wait for the next call
+    posix::size_t count = 0;
+    node_t* first = nullptr;
+    node_t* last = nullptr;
+    for(node_t* node; count < limit && (node = pop()) != nullptr; ++count)
+    {
+      function(node->value());
+      node->value().~T();
+      node->next.store(first, std::memory_order_relaxed);
+      if(first == nullptr)
+        last = node;
+      first = node;
+    }
+
+    if(first != nullptr) // recycle all consumed nodes at once
+      release(first, last);
+    return m_count.fetch_sub(count) != count;
+  }
+
+private:
+  void push(node_t* node) noexcept
+  {
+    node_t* prev = m_tail.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  node_t* pop(void) noexcept
+  {
+    node_t* head = m_head;
+    node_t* next = head->next.load(std::memory_order_acquire);
+    if(head == &m_stub) // skip the stub
+    {
+      if(next == nullptr) // empty
+        return nullptr;
+      m_head = head = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if(next == nullptr) // if this is the last node
+    {
+      if(head != m_tail.load(std::memory_order_acquire)) // a producer is still linking a node
+        return nullptr;
+      push(&m_stub); // requeue the stub so the last node can be detached
+      next = head->next.load(std::memory_order_acquire);
+      if(next == nullptr)
+        return nullptr;
+    }
+    m_head = next;
+    return head;
+  }
+
+  static node_t* acquire(void) noexcept
+  {
+    node_t* node = t_cache.head;
+    if(node == nullptr) // take all recycled nodes
+      node = s_free.exchange(nullptr, std::memory_order_acquire);
+
+    if(node == nullptr) // allocate a new block of nodes (never freed)
+    {
+      node = static_cast<node_t*>(posix::malloc(sizeof(node_t) * MPSC_NODE_BLOCK));
+      if(node == nullptr)
+        return nullptr;
+      for(posix::size_t i = 0; i < MPSC_NODE_BLOCK; ++i) // link new nodes together
+      {
+        new (node + i) node_t;
+        node[i].next.store(i + 1 < MPSC_NODE_BLOCK ? node + i + 1 : nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    t_cache.head = node->next.load(std::memory_order_relaxed);
+    return node;
+  }
+
+  static void release(node_t* first, node_t* last) noexcept
+  {
+    node_t* head = s_free.load(std::memory_order_relaxed);
+    do {
+      last->next.store(head, std::memory_order_relaxed);
+    } while(!s_free.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  node_t* m_head; // consumer only
+  std::atomic<node_t*> m_tail;
+  std::atomic<posix::size_t> m_count; // queued values that the consumer has not accounted for
+  node_t m_stub;
+
+  static std::atomic<node_t*> s_free; // recycled nodes (shared by all threads)
+  static thread_local cache_t t_cache;
+};
+
+template<typename T> std::atomic<typename mpscqueue<T>::node_t*> mpscqueue<T>::s_free(nullptr);
+template<typename T> thread_local typename mpscqueue<T>::cache_t mpscqueue<T>::t_cache;
+
+#endif // MPSCQUEUE_H
@@ -388,6 +388,9 @@ namespace posix
   static inline ssize_t read(fd_t fd, void* buffer, size_t length) noexcept
     { return ignore_interruption(::read, fd, buffer, length); }
 
+  static inline ssize_t pread(fd_t fd, void* buffer, size_t length, off_t offset) noexcept
+    { return ignore_interruption(::pread, fd, buffer, length, offset); }
+
 // POSIX wrappers
   static inline bool chmod(const char* path, mode_t mode) noexcept
     { return ignore_interruption(::chmod, path, mode) == success_response; }
@@ -0,0 +1,109 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+// STL
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+
+// vector that stores the first few elements inline (no allocation)
+template<typename T, posix::size_t N>
+class smallvector
+{
+public:
+  smallvector(void) noexcept
+    : m_data(inline_data()), m_size(0), m_capacity(N) { }
+
+  ~smallvector(void) noexcept
+  {
+    clear();
+    if(m_data != inline_data())
+      posix::free(m_data);
+  }
+
+  smallvector(const smallvector& other) = delete;
+  smallvector& operator=(const smallvector& other) = delete;
+
+  bool          empty(void) const noexcept { return !m_size; }
+  posix::size_t size (void) const noexcept { return m_size; }
+
+  T* begin(void) noexcept { return m_data; }
+  T* end  (void) noexcept { return m_data + m_size; }
+  const T* begin(void) const noexcept { return m_data; }
+  const T* end  (void) const noexcept { return m_data + m_size; }
+
+  T& operator [](posix::size_t pos) noexcept { return m_data[pos]; }
+  const T& operator [](posix::size_t pos) const noexcept { return m_data[pos]; }
+
+  template<typename... ArgTypes>
+  bool emplace_back(ArgTypes&&... args) noexcept
+  {
+    if(m_size == m_capacity && !reserve(m_capacity * 2))
+      return false;
+    new (m_data + m_size) T(std::forward<ArgTypes>(args)...);
+    ++m_size;
+    return true;
+  }
+
+  bool reserve(posix::size_t capacity) noexcept
+  {
+    if(capacity <= m_capacity)
+      return true;
+
+    T* data = static_cast<T*>(posix::malloc(sizeof(T) * capacity));
+    if(data == nullptr)
+      return false;
+
+    for(posix::size_t i = 0; i < m_size; ++i) // relocate elements
+    {
+      new (data + i) T(std::move(m_data[i]));
+      m_data[i].~T();
+    }
+
+    if(m_data != inline_data())
+      posix::free(m_data);
+    m_data = data;
+    m_capacity = capacity;
+    return true;
+  }
+
+  // erases every element matching the predicate in a single pass (preserves order)
+  template<typename Pred>
+  void remove_if(Pred predicate) noexcept
+  {
+    T* dest = m_data;
+    for(T* pos = m_data; pos != end(); ++pos)
+    {
+      if(!predicate(*pos))
+      {
+        if(dest != pos)
+          *dest = std::move(*pos);
+        ++dest;
+      }
+    }
+
+    for(T* pos = dest; pos != end(); ++pos)
+      pos->~T();
+    m_size = posix::size_t(dest - m_data);
+  }
+
+  void clear(void) noexcept
+  {
+    for(T* pos = m_data; pos != end(); ++pos)
+      pos->~T();
+    m_size = 0;
+  }
+
+private:
+  T* inline_data(void) noexcept { return reinterpret_cast<T*>(&m_inline); }
+
+  T* m_data;
+  posix::size_t m_size;
+  posix::size_t m_capacity;
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type m_inline;
+};
+
+#endif // SMALLVECTOR_H
@@ -4,6 +4,8 @@
 // POSIX
 #include <sys/un.h>     // for struct sockaddr_un
 #include <netinet/in.h> // for struct sockaddr_in
+#include <netinet/tcp.h> // for TCP_NODELAY
+#include <arpa/inet.h>  // for inet_pton()
 #include <sys/socket.h> // for socket()
 #include <poll.h>       // for poll()
 
@@ -20,6 +22,14 @@
 #include <linux/netlink.h>
 #endif
 
+#if !defined(MSG_WAITFORONE) // no recvmmsg()/sendmmsg()
+struct mmsghdr
+{
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif
+
 enum class EDomain : sa_family_t
 {
 // POSIX required
@@ -86,9 +96,17 @@ enum class EType : int
 
 namespace posix
 {
-  struct sockaddr_t : sockaddr_un
+  struct sockaddr_t : sockaddr_un // large enough for every supported address type
   {
-    size_t size(void) const noexcept { return sizeof(sun_family) + posix::strlen(sun_path); }
+    size_t size(void) const noexcept
+    {
+      switch(sun_family)
+      {
+        case AF_INET : return sizeof(sockaddr_in);
+        case AF_INET6: return sizeof(sockaddr_in6);
+        default      : return sizeof(sun_family) + posix::strlen(sun_path);
+      }
+    }
     operator struct sockaddr*(void) noexcept { return reinterpret_cast<struct sockaddr*>(this); }
     operator const struct sockaddr*(void) const noexcept { return reinterpret_cast<const struct sockaddr*>(this); }
 
@@ -96,7 +114,39 @@ namespace posix
     constexpr_maybe sockaddr_t& operator = (sa_family_t family) noexcept { sun_family = family; return *this; }
     constexpr_maybe sockaddr_t& operator = (EDomain family) noexcept { return operator =(static_cast<sa_family_t>(family)); }
     sockaddr_t& operator = (const char* path) noexcept { posix::strncpy(sun_path, path, sizeof(sockaddr_un::sun_path)); return *this; }
+
+    // numeric IPv4 or IPv6 address (e.g. "127.0.0.1" or "::1"), also sets the family
+    bool setAddress(const char* address, in_port_t port) noexcept
+    {
+      sockaddr_in*  in4 = reinterpret_cast<sockaddr_in *>(this);
+      sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(this);
+      posix::memset(this, 0, sizeof(sockaddr_un));
+      if(::inet_pton(AF_INET, address, &in4->sin_addr) == 1)
+      {
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        return true;
+      }
+      if(::inet_pton(AF_INET6, address, &in6->sin6_addr) == 1)
+      {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        return true;
+      }
+      return false;
+    }
+
+    in_port_t port(void) const noexcept
+    {
+      switch(sun_family)
+      {
+        case AF_INET : return ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
+        case AF_INET6: return ntohs(reinterpret_cast<const sockaddr_in6*>(this)->sin6_port);
+        default      : return 0;
+      }
+    }
   };
+  static_assert(sizeof(sockaddr_un) >= sizeof(sockaddr_in6), "sockaddr_t is unable to hold IPv6 addresses");
 
   struct inetaddr_t : sockaddr_in
   {
@@ -132,6 +182,19 @@ namespace posix
     return fd;
   }
 
+  // accepts a non-blocking connection (close on exec*())
+  static inline fd_t accept4(fd_t sockfd, sockaddr* addr = NULL, socklen_t* addrlen = NULL) noexcept
+  {
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+    return ignore_interruption<int, int, sockaddr*, socklen_t*, int>(::accept4, sockfd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    fd_t fd = accept(sockfd, addr, addrlen);
+    if(fd != error_response)
+      posix::donotblock(fd);
+    return fd;
+#endif
+  }
+
   static inline bool listen(fd_t sockfd, int backlog = SOMAXCONN) noexcept
     { return ::listen(sockfd, backlog) == success_response; }
 
@@ -141,6 +204,9 @@ namespace posix
   static inline bool bind(fd_t sockfd, const sockaddr* addr, socklen_t addrlen) noexcept
     { return ::bind(sockfd, addr, addrlen) == success_response; }
 
+  static inline bool setsockopt(fd_t sockfd, int level, int option, int value) noexcept
+    { return ::setsockopt(sockfd, level, option, &value, sizeof(value)) == success_response; }
+
   static inline ssize_t send(fd_t sockfd, const void* buffer, size_t length, int flags = MSG_NOSIGNAL) noexcept
     { return ignore_interruption(::send, sockfd, buffer, length, flags); }
 
@@ -153,6 +219,41 @@ namespace posix
   static inline ssize_t recvmsg(fd_t sockfd, msghdr* msg, int flags = 0) noexcept
     { return ignore_interruption(::recvmsg, sockfd, msg, flags); }
 
+  // returns the number of messages received/sent (msg_len is set to the size of each)
+#if defined(MSG_WAITFORONE)
+  static inline int recvmmsg(fd_t sockfd, mmsghdr* msgvec, unsigned int vlen, int flags = 0) noexcept
+    { return ignore_interruption<int, int, mmsghdr*, unsigned int, int, timespec*>(::recvmmsg, sockfd, msgvec, vlen, flags, NULL); }
+
+  static inline int sendmmsg(fd_t sockfd, mmsghdr* msgvec, unsigned int vlen, int flags = MSG_NOSIGNAL) noexcept
+    { return ignore_interruption<int, int, mmsghdr*, unsigned int, int>(::sendmmsg, sockfd, msgvec, vlen, flags); }
+#else
+  static inline int recvmmsg(fd_t sockfd, mmsghdr* msgvec, unsigned int vlen, int flags = 0) noexcept
+  {
+    unsigned int count = 0;
+    for(ssize_t rval; count < vlen; ++count)
+    {
+      rval = recvmsg(sockfd, &msgvec[count].msg_hdr, flags | (count ? MSG_DONTWAIT : 0));
+      if(rval == error_response)
+        break;
+      msgvec[count].msg_len = static_cast<unsigned int>(rval);
+    }
+    return count ? int(count) : error_response;
+  }
+
+  static inline int sendmmsg(fd_t sockfd, mmsghdr* msgvec, unsigned int vlen, int flags = MSG_NOSIGNAL) noexcept
+  {
+    unsigned int count = 0;
+    for(ssize_t rval; count < vlen; ++count)
+    {
+      rval = sendmsg(sockfd, &msgvec[count].msg_hdr, flags);
+      if(rval == error_response)
+        break;
+      msgvec[count].msg_len = static_cast<unsigned int>(rval);
+    }
+    return count ? int(count) : error_response;
+  }
+#endif
+
   static inline int poll(pollfd* fds, nfds_t nfds, int timeout = -1) noexcept
     { return ignore_interruption(::poll, fds, nfds, timeout); }
 }
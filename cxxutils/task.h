@@ -0,0 +1,59 @@
+#ifndef TASK_H
+#define TASK_H
+
+// STL
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+#if !defined(TASK_STORAGE_SIZE)
+#define TASK_STORAGE_SIZE 64 // enough for a slot, an object pointer and a few arguments
+#endif
+
+// a queued void() call that stores small function objects inline (no allocation)
+class task_t
+{
+  typedef std::integral_constant<bool, true > stored_inline;
+  typedef std::integral_constant<bool, false> stored_on_heap;
+
+public:
+  template<typename Func>
+  task_t(Func&& function) noexcept
+  {
+    typedef typename std::decay<Func>::type func_type;
+    construct<func_type>(std::forward<Func>(function),
+                         std::integral_constant<bool, sizeof(func_type) <= TASK_STORAGE_SIZE &&
+                                                      alignof(std::max_align_t) % alignof(func_type) == 0>());
+  }
+
+  ~task_t(void) noexcept { m_destroy(&m_storage); }
+
+  task_t(const task_t& other) = delete;
+  task_t& operator=(const task_t& other) = delete;
+
+  void operator()(void) noexcept { m_invoke(&m_storage); }
+
+private:
+  template<typename T, typename Func>
+  void construct(Func&& function, stored_inline) noexcept
+  {
+    new (&m_storage) T(std::forward<Func>(function));
+    m_invoke  = [](void* storage) noexcept { (*static_cast<T*>(storage))(); };
+    m_destroy = [](void* storage) noexcept { static_cast<T*>(storage)->~T(); };
+  }
+
+  template<typename T, typename Func>
+  void construct(Func&& function, stored_on_heap) noexcept // function object is too large
+  {
+    *reinterpret_cast<T**>(&m_storage) = new T(std::forward<Func>(function));
+    m_invoke  = [](void* storage) noexcept { (**static_cast<T**>(storage))(); };
+    m_destroy = [](void* storage) noexcept { delete *static_cast<T**>(storage); };
+  }
+
+  typename std::aligned_storage<TASK_STORAGE_SIZE, alignof(std::max_align_t)>::type m_storage;
+  void (*m_invoke)(void*) noexcept;
+  void (*m_destroy)(void*) noexcept;
+};
+
+#endif // TASK_H
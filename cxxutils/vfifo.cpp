@@ -1,58 +1,404 @@
 #include "vfifo.h"
 
-vfifo::vfifo(posix::ssize_t length) noexcept  // default size is 64 KiB
-  : m_data(NULL), m_capacity(0)
+// STL
+#include <new>
+
+// POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+# if defined(SYS_memfd_create) /* Linux 3.17+ */
+#  define MEMFD_RING
+#  if !defined(MFD_CLOEXEC)
+#   define MFD_CLOEXEC 0x0001U
+#  endif
+#  if !defined(MFD_ALLOW_SEALING)
+#   define MFD_ALLOW_SEALING 0x0002U
+#  endif
+#  if !defined(F_ADD_SEALS)
+#   define F_ADD_SEALS 1033
+#   define F_GET_SEALS 1034
+#  endif
+#  if !defined(F_SEAL_SEAL)
+#   define F_SEAL_SEAL   0x0001
+#   define F_SEAL_SHRINK 0x0002
+#   define F_SEAL_GROW   0x0004
+#  endif
+# endif
+#endif
+
+// creates an anonymous shared memory object
+static posix::fd_t ring_fd(void) noexcept
+{
+#if defined(MEMFD_RING)
+  return posix::fd_t(::syscall(SYS_memfd_create, "vfifo", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+#else
+  static std::atomic<uint32_t> counter(0);
+  char name[64];
+  posix::snprintf(name, sizeof(name), "/vfifo-%d-%u", int(posix::getpid()), counter.fetch_add(1, std::memory_order_relaxed));
+  posix::fd_t fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if(fd != posix::invalid_descriptor)
+  {
+    ::shm_unlink(name); // the name is no longer needed
+    posix::fcntl(fd, F_SETFD, FD_CLOEXEC); // close on exec*()
+  }
+  return fd;
+#endif
+}
+
+// fixes the size of the shared memory object so a peer can't make the mappings fault
+static bool ring_seal(posix::fd_t fd) noexcept
+{
+#if defined(MEMFD_RING)
+  return posix::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != posix::error_response;
+#else
+  (void)fd;
+  return true; // POSIX shared memory can't be sealed
+#endif
+}
+
+// the size of the shared memory object can no longer change
+static bool ring_sealed(posix::fd_t fd) noexcept
+{
+#if defined(MEMFD_RING)
+  int seals = posix::fcntl(fd, F_GET_SEALS);
+  return seals != posix::error_response &&
+         (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) == (F_SEAL_SHRINK | F_SEAL_GROW);
+#else
+  (void)fd;
+  return true;
+#endif
+}
+
+// maps the same pages twice, back to back, so any span up to length bytes is contiguous
+static void* ring_map(posix::fd_t fd, posix::size_t length) noexcept
+{
+  void* reserved = ::mmap(NULL, length * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // reserve address space
+  if(reserved == MAP_FAILED)
+    return nullptr;
+
+  uint8_t* base = static_cast<uint8_t*>(reserved);
+  if(::mmap(base, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+     ::mmap(base + length, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+  {
+    ::munmap(base, length * 2);
+    return nullptr;
+  }
+  return base;
+}
+
+vfifo::vfifo(posix::ssize_t length, Mode mode) noexcept  // default size is 64 KiB
+  : m_shared(nullptr), m_data(NULL), m_capacity(0), m_mode(mode)
 {
   reset();
   allocate(length);
 }
 
 vfifo::vfifo(const vfifo& other) noexcept
+  : m_shared(other.m_shared),
+    m_data(other.m_data),
+    m_virt_begin(other.m_virt_begin),
+    m_virt_end(other.m_virt_end),
+    m_capacity(other.m_capacity),
+    m_ok(other.m_ok),
+    m_mode(other.m_mode)
 {
-  reset();
-  m_capacity = m_virt_end = other.size();
-  m_data = posix::malloc(m_capacity);
+  if(m_shared != nullptr)
+    m_shared->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+vfifo::vfifo(const vfifo& other, posix::ssize_t pos, posix::ssize_t length) noexcept
+  : vfifo(other)
+{
+  m_data = other.data() + pos;
+  m_mode = Linear; // a view is a plain window, even into ring storage
+  m_virt_begin = 0;
+  m_virt_end = m_capacity = length; // nothing can be appended
 }
 
 vfifo::~vfifo(void) noexcept
 {
-  posix::free(m_data);
+  release();
+}
+
+void vfifo::release(void) noexcept
+{
+  if(m_shared != nullptr &&
+     m_shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) // last copy
+  {
+    if(m_shared->mapping != nullptr)
+      ::munmap(m_shared->mapping, m_shared->mapped * 2);
+    if(m_shared->fd != posix::invalid_descriptor)
+      posix::close(m_shared->fd);
+    posix::free(m_shared);
+  }
+  m_shared = nullptr;
   m_data = NULL;
 }
 
+bool vfifo::detach(posix::ssize_t length) noexcept
+{
+  if(length < size())
+    length = size();
+
+  posix::fd_t fd = posix::invalid_descriptor;
+  void* mapping = nullptr;
+  if(ring())
+  {
+    posix::ssize_t page = ::sysconf(_SC_PAGESIZE);
+    length = (length + page - 1) / page * page; // grow in page multiples
+    if(!length)
+      length = page;
+    fd = ring_fd();
+    if(fd != posix::invalid_descriptor &&
+       ::ftruncate(fd, off_t(length)) == posix::success_response &&
+       ring_seal(fd))
+      mapping = ring_map(fd, posix::size_t(length));
+    if(fd != posix::invalid_descriptor &&
+       (mapping == nullptr || m_mode != SharedRing)) // the mappings keep the pages alive
+    {
+      posix::close(fd);
+      fd = posix::invalid_descriptor;
+    }
+    if(mapping == nullptr)
+      return m_ok = false;
+  }
+
+  shared_t* storage = static_cast<shared_t*>(posix::malloc(sizeof(shared_t) + (ring() ? 0 : posix::size_t(length))));
+  if(storage == nullptr)
+  {
+    if(mapping != nullptr)
+      ::munmap(mapping, posix::size_t(length) * 2);
+    if(fd != posix::invalid_descriptor)
+      posix::close(fd);
+    return m_ok = false;
+  }
+  new (storage) shared_t { { 1 }, fd, mapping, posix::size_t(length) };
+
+  void* dest = ring() ? mapping : static_cast<void*>(storage + 1);
+  if(size())
+    posix::memcpy(dest, data(), posix::size_t(size()));
+  m_virt_end = size();
+  m_virt_begin = 0;
+  m_capacity = length;
+
+  release();
+  m_shared = storage;
+  m_data = dest;
+  return true;
+}
+
 bool vfifo::allocate(posix::ssize_t length) noexcept
 {
+  if(!exclusive()) // other copies still use this storage
+    return detach(length > capacity() ? length : capacity());
+
+  if(ring()) // data is always contiguous: only growing copies it
+    return length <= capacity() || detach(length);
+
   if(discarded() && size())
-    posix::memmove(m_data, data(), size());
+    posix::memmove(m_data, data(), posix::size_t(size()));
+  m_virt_end = size();
+  m_virt_begin = 0;
 
   if(length > capacity())
   {
-    m_data = posix::realloc(m_data, length);
+    shared_t* storage = static_cast<shared_t*>(posix::realloc(m_shared, sizeof(shared_t) + posix::size_t(length)));
+    if(storage == nullptr)
+      return false;
+    m_shared = storage;
+    m_data = storage + 1;
     m_capacity = length;
   }
   return m_data != NULL;
 }
 
+bool vfifo::setMode(Mode mode, posix::ssize_t length) noexcept
+{
+  Mode previous = m_mode;
+  m_mode = mode;
+  if(detach(length > capacity() ? length : capacity()))
+    return true;
+  m_mode = previous; // still using the old storage
+  return false;
+}
+
+bool vfifo::attach(posix::fd_t ring, posix::ssize_t length) noexcept
+{
+  struct stat info;
+  void* mapping = nullptr;
+  shared_t* storage = nullptr;
+  posix::ssize_t page = ::sysconf(_SC_PAGESIZE);
+
+  if(length > 0 &&
+     length % page == 0 &&
+     ring_sealed(ring) && // the peer can't resize it under the mappings
+     ::fstat(ring, &info) == posix::success_response &&
+     info.st_size == length &&
+     (mapping = ring_map(ring, posix::size_t(length))) != nullptr &&
+     (storage = static_cast<shared_t*>(posix::malloc(sizeof(shared_t)))) == nullptr)
+    ::munmap(mapping, posix::size_t(length) * 2);
+
+  if(storage == nullptr)
+  {
+    posix::close(ring);
+    return m_ok = false;
+  }
+  new (storage) shared_t { { 1 }, ring, mapping, posix::size_t(length) };
+
+  release();
+  m_shared = storage;
+  m_data = mapping;
+  m_mode = SharedRing;
+  m_capacity = length;
+  reset();
+  return true;
+}
+
 void vfifo::reset(void) noexcept
 {
   m_virt_end = m_virt_begin = 0;
   clearError();
 }
 
-// make sure strings are read in properly!
-template<> vfifo& vfifo::operator << (const std::string& arg) noexcept
+bool vfifo::produce(posix::ssize_t length) noexcept
+{
+  if(length < 0 || length > unused())
+    return m_ok = false;
+  m_virt_end += length;
+  return true;
+}
+
+bool vfifo::consume(posix::ssize_t length) noexcept
+{
+  if(length < 0 || length > size())
+    return m_ok = false;
+  m_virt_begin += length;
+  drained();
+  return true;
+}
+
+iovec vfifo::writable(void) noexcept
+{
+  if(ring() && shared() && !detach(capacity())) // free space aliases consumed bytes that copies may still read
+    return { NULL, 0 };
+  return { dataEnd(), posix::size_t(unused()) };
+}
+
+vfifo vfifo::view(posix::ssize_t pos, posix::ssize_t length) const noexcept
+{
+  if(pos < 0 || length < 0 || pos + length > size())
+    return vfifo(0);
+  return vfifo(*this, pos, length);
+}
+
+bool vfifo::reserve(posix::ssize_t length) noexcept
+{
+  if(unused() >= length)
+    return true;
+  posix::ssize_t needed = size() + length;
+  if(!ring() && needed <= capacity()) // compacting is enough
+    return allocate(capacity()) || (m_ok = false);
+  return allocate(needed > capacity() * 2 ? needed : capacity() * 2) || (m_ok = false);
+}
+
+bool vfifo::push_header(uint16_t type, posix::size_t length) noexcept
+{
+  if(!reserve(MaxHeaderSize) ||
+     !push<uint16_t>(type))
+    return false;
+  if(length < UINT16_MAX)
+    return push<uint16_t>(uint16_t(length));
+  if(!push<uint16_t>(UINT16_MAX)) // escape to 32-bit length
+    return false;
+  if(length < UINT32_MAX)
+    return push<uint32_t>(uint32_t(length));
+  return push<uint32_t>(UINT32_MAX) && // escape to 64-bit length
+         push<uint64_t>(uint64_t(length));
+}
+
+bool vfifo::push_array(const void* arg, uint16_t type, posix::size_t length) noexcept
+{
+  posix::ssize_t bytes = posix::ssize_t(length * type);
+  if(!reserve(MaxHeaderSize + bytes) ||
+     !push_header(type, length))
+    return false;
+  if(bytes)
+    posix::memcpy(dataEnd(), arg, posix::size_t(bytes));
+  m_virt_end += bytes;
+  return true;
+}
+
+bool vfifo::peek_header(uint16_t& type, posix::size_t& length, posix::ssize_t& header_size) const noexcept
+{
+  const uint8_t* pos = data<uint8_t>();
+  uint16_t short_length;
+  uint32_t long_length;
+  uint64_t huge_length;
+
+  header_size = sizeof(uint16_t) * 2;
+  if(size() < header_size)
+    return false;
+  posix::memcpy(&type, pos, sizeof(uint16_t));
+  posix::memcpy(&short_length, pos + sizeof(uint16_t), sizeof(uint16_t));
+  length = short_length;
+  if(short_length < UINT16_MAX)
+    return true;
+
+  header_size += sizeof(uint32_t);
+  if(size() < header_size)
+    return false;
+  posix::memcpy(&long_length, pos + sizeof(uint16_t) * 2, sizeof(uint32_t));
+  length = long_length;
+  if(long_length < UINT32_MAX)
+    return true;
+
+  header_size += sizeof(uint64_t);
+  if(size() < header_size)
+    return false;
+  posix::memcpy(&huge_length, pos + sizeof(uint16_t) * 2 + sizeof(uint32_t), sizeof(uint64_t));
+  length = posix::size_t(huge_length);
+  return true;
+}
+
+posix::size_t vfifo::peek_length(uint16_t type) const noexcept
+{
+  uint16_t stored_type;
+  posix::size_t length;
+  posix::ssize_t header_size;
+  if(!peek_header(stored_type, length, header_size) ||
+     stored_type != type ||
+     posix::size_t(size() - header_size) / (type == Complex ? 1 : type) < length) // more than is queued
+    return 0;
+  return length;
+}
+
+bool vfifo::pull_header(uint16_t type, posix::size_t& length) noexcept
 {
-  if(posix::ssize_t(arg.size()) > unused())
-    allocate(capacity() * 2);
-  serialize_arr(arg.data(), uint16_t(arg.size()));
-  return *this;
+  uint16_t stored_type;
+  posix::ssize_t header_size;
+  if(!peek_header(stored_type, length, header_size) ||
+     stored_type != type)
+    return m_ok = false;
+  return consume(header_size);
 }
 
-// make sure strings are read in properly!
-template<> vfifo& vfifo::operator << (const std::wstring& arg) noexcept
+bool vfifo::pull_array(void* arg, uint16_t type, posix::size_t length) noexcept
 {
-  if(posix::ssize_t(arg.size()) > unused())
-    allocate(capacity() * 2);
-  serialize_arr(arg.data(), uint16_t(arg.size()));
-  return *this;
+  uint16_t stored_type;
+  posix::size_t stored_length;
+  posix::ssize_t header_size;
+  if(!peek_header(stored_type, stored_length, header_size) ||
+     stored_type != type || // size matches
+     stored_length != length || // length matches
+     posix::size_t(size() - header_size) / type < length) // no buffer underflow
+    return m_ok = false;
+  posix::ssize_t bytes = posix::ssize_t(length * type);
+  if(bytes)
+    posix::memcpy(arg, data() + header_size, posix::size_t(bytes));
+  return consume(header_size + bytes);
 }
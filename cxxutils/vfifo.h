@@ -4,10 +4,16 @@
 // POSIX++
 #include <cwchar>
 
+// POSIX
+#include <sys/uio.h>
+
 // STL
+#include <atomic>
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <utility>
+#include <type_traits>
 
 // PUT
 #include <put/cxxutils/posix_helpers.h>
@@ -18,12 +24,19 @@
 # define constexpr_maybe inline
 #endif
 
-// virtual queue class
+// virtual queue class (copies share storage until one of them is modified)
 class vfifo
 {
 public:
-  vfifo(posix::ssize_t length = 0x0000FFFF) noexcept;  // default size is 64 KiB
-  vfifo(const vfifo& other) noexcept;
+  enum Mode : uint8_t
+  {
+    Linear = 0, // heap storage, compacted with memmove()
+    Ring,       // double-mapped storage, never compacted (capacity is a page multiple)
+    SharedRing, // ring storage that can be mapped by another process (see descriptor() and attach())
+  };
+
+  vfifo(posix::ssize_t length = 0x0000FFFF, Mode mode = Linear) noexcept;  // default size is 64 KiB
+  vfifo(const vfifo& other) noexcept; // shares storage (no allocation or copy)
   ~vfifo(void) noexcept;
 
   vfifo& operator=(const vfifo& other) = delete;
@@ -67,12 +80,25 @@ public:
   constexpr_maybe posix::ssize_t size     (void) const noexcept { return m_virt_end - m_virt_begin; }
   constexpr_maybe posix::ssize_t discarded(void) const noexcept { return m_virt_begin; }
   constexpr_maybe posix::ssize_t used     (void) const noexcept { return m_virt_end; }
-  constexpr_maybe posix::ssize_t unused   (void) const noexcept { return m_capacity - m_virt_end; }
+  constexpr_maybe posix::ssize_t unused   (void) const noexcept { return m_capacity - (ring() ? size() : m_virt_end); }
   constexpr_maybe posix::ssize_t capacity (void) const noexcept { return m_capacity; }
 
   bool allocate(posix::ssize_t length) noexcept;
   void reset(void) noexcept;
 
+  bool produce(posix::ssize_t length) noexcept; // adds bytes written directly to dataEnd()
+  bool consume(posix::ssize_t length) noexcept; // discards bytes from data()
+  vfifo view(posix::ssize_t pos, posix::ssize_t length) const noexcept; // read-only copy of part of data() (shares storage)
+  bool shared(void) const noexcept { return m_shared != nullptr && m_shared->refs.load(std::memory_order_acquire) > 1; }
+  constexpr_maybe bool ring(void) const noexcept { return m_mode != Linear; }
+  posix::fd_t descriptor(void) const noexcept { return m_shared == nullptr ? posix::invalid_descriptor : m_shared->fd; } // SharedRing storage
+  bool setMode(Mode mode, posix::ssize_t length = 0) noexcept; // moves data() to new storage of at least length bytes
+  bool attach(posix::fd_t ring, posix::ssize_t length) noexcept; // replaces the queue with another process's sealed SharedRing storage of length bytes (takes ownership of ring)
+
+  // spans for readv()/writev(): both are always contiguous in ring mode
+  iovec readable(void) const noexcept { return { data(), posix::size_t(size()) }; }
+  iovec writable(void) noexcept; // follow with produce()
+
   template<typename T = char> constexpr T& front   (void) noexcept       { return *data<T>(); }
   template<typename T = char> constexpr T& back    (void) noexcept       { return *dataEnd<T>(); }
 
@@ -80,13 +106,41 @@ public:
   template<typename T = char> constexpr T* dataEnd (void) const noexcept { return reinterpret_cast<T*>(static_cast<uint8_t*>(m_data) + m_virt_end  ); } // lgtm[cpp/incorrect-string-type-conversion]
 
   template<typename T = char> constexpr T* begin   (void) const noexcept { return reinterpret_cast<T*>(m_data); } // lgtm[cpp/incorrect-string-type-conversion]
-  template<typename T = char> constexpr T* end     (void) const noexcept { return reinterpret_cast<T*>(static_cast<uint8_t*>(m_data) + m_capacity); } // lgtm[cpp/incorrect-string-type-conversion]
+  template<typename T = char> constexpr T* end     (void) const noexcept { return reinterpret_cast<T*>(static_cast<uint8_t*>(m_data) + (ring() ? m_virt_begin : 0) + m_capacity); } // lgtm[cpp/incorrect-string-type-conversion]
 
 private:
+  struct alignas(alignof(std::max_align_t)) shared_t // precedes the storage (unless mapped)
+  {
+    std::atomic<uint32_t> refs;
+    posix::fd_t fd; // SharedRing storage
+    void* mapping; // ring storage: two adjacent mappings of the same pages
+    posix::size_t mapped; // length of one mapping
+  };
+
+  vfifo(const vfifo& other, posix::ssize_t pos, posix::ssize_t length) noexcept;
+  bool exclusive(void) const noexcept { return m_shared != nullptr && !shared() && (ring() || m_data == m_shared + 1); }
+  bool detach(posix::ssize_t length) noexcept; // copies data() to new storage
+  void release(void) noexcept;
+
+  void drained(void) noexcept
+  {
+    if(!ring())
+    {
+      if(empty() && !shared()) // if buffer is empty (and no other copy is using it)
+        reset(); // move back to start of buffer
+    }
+    else if(m_virt_begin >= m_capacity) // read position entered the second mapping (offsets keep their place in the ring)
+    {
+      m_virt_begin -= m_capacity;
+      m_virt_end -= m_capacity;
+    }
+  }
+
   template<typename T>
   bool push(const T& d) noexcept
   {
-    if(dataEnd() + sizeof(T) > end()) // check if this would overflow buffer
+    if((!exclusive() && !detach(m_capacity)) || // don't modify storage shared with other copies
+       dataEnd() + sizeof(T) > end()) // check if this would overflow buffer
       return m_ok = false; // avoid buffer overflow!
     back<T>() = d;
     m_virt_end += sizeof(T);
@@ -99,59 +153,61 @@ private:
     if(data() + sizeof(T) > dataEnd()) // check if this would underflow buffer
       return m_ok = false; // avoid buffer underflow!
     m_virt_begin += sizeof(T);
-    if(empty()) // if buffer is empty
-      reset(); // move back to start of buffer
+    drained();
     return true;
   }
 
+  shared_t* m_shared;
   void* m_data;
   posix::ssize_t m_virt_begin;
   posix::ssize_t m_virt_end;
   posix::ssize_t m_capacity;
   bool m_ok;
+  Mode m_mode;
 
 // === serializer backends ===
+// each value is written as: [uint16_t element size (or Complex)][length][elements]
+// the stream has no version marker: lengths under 0xFFFF are a single uint16_t (as they always were)
+// a uint16_t of 0xFFFF escapes to a uint32_t length and a uint32_t of 0xFFFFFFFF escapes to a uint64_t length
+// so only values with 0xFFFF or more elements can't be read by older code
 private:
+  enum : uint16_t { Complex = UINT16_MAX }; // element size of a non-POD element type
+  enum : posix::ssize_t { MaxHeaderSize = sizeof(uint16_t) * 2 + sizeof(uint32_t) + sizeof(uint64_t) };
+
+  template<typename T>
+  struct is_pod_array : std::is_trivially_copyable<T> { };
+
+  template<typename T> // std::vector<bool> is packed so it has no data() to copy from
+  struct is_bulk_vector : std::integral_constant<bool, is_pod_array<T>::value && !std::is_same<T, bool>::value> { };
+
+  template<typename T> struct element { typedef T type; };
+  template<typename K, typename V> struct element<std::pair<const K, V>> { typedef std::pair<K, V> type; }; // map entries
+
+  bool reserve(posix::ssize_t length) noexcept; // make room to append length bytes
+  bool push_header(uint16_t type, posix::size_t length) noexcept;
+  bool push_array(const void* arg, uint16_t type, posix::size_t length) noexcept; // one bounds check and memcpy()
+  bool peek_header(uint16_t& type, posix::size_t& length, posix::ssize_t& header_size) const noexcept;
+  bool pull_header(uint16_t type, posix::size_t& length) noexcept;
+  bool pull_array(void* arg, uint16_t type, posix::size_t length) noexcept;
+  posix::size_t peek_length(uint16_t type) const noexcept;
+
   // dummy functions
   static void serialize(void) noexcept { }
   static void deserialize(void) noexcept { }
 
 // sized array
   template<typename T>
-  void serialize_arr(const T* arg, uint16_t length) noexcept
-  {
-    if(size() < discarded())
-      allocate(m_capacity);
-    if(posix::ssize_t(sizeof(T)) > unused())
-      allocate(m_capacity * 2);
-
-    if(push<uint16_t>(sizeof(T)) &&
-       push<uint16_t>(length))
-      for(posix::size_t i = 0; m_ok && i < length; ++i)
-        push<T>(arg[i]);
-  }
-
-  template<typename T>
-  void deserialize_arr(T* arg, uint16_t length) noexcept
+  void serialize_arr(const T* arg, posix::size_t length) noexcept
   {
-    if(front<uint16_t>() == sizeof(T) &&  // size matches
-       pull <uint16_t>() &&               // no buffer underflow
-       front<uint16_t>() == length &&     // length matches
-       pull <uint16_t>())                 // no buffer underflow
-      for(posix::size_t i = 0; m_ok && i < length; ++i, pull<T>())
-        arg[i] = front<T>();
+    static_assert(is_pod_array<T>::value, "array elements must be trivially copyable");
+    push_array(arg, sizeof(T), length);
   }
 
-// vector helpers
-  template<typename T>
-  void serialize_arr(const std::vector<T>& arg) noexcept
-    { serialize_arr(arg.data(), arg.size()); }
-
   template<typename T>
-  void deserialize_arr(std::vector<T>& arg) noexcept
+  void deserialize_arr(T* arg, posix::size_t length) noexcept
   {
-    arg.resize(data<uint16_t>()[1]);
-    deserialize_arr(const_cast<T*>(arg.data()), arg.size()); // not guaranteed to work per the STL spec but should never fail catastrophically.
+    static_assert(is_pod_array<T>::value, "array elements must be trivially copyable");
+    pull_array(arg, sizeof(T), length);
   }
 
 // simple types
@@ -163,43 +219,76 @@ private:
   void deserialize(T& arg) noexcept
     { deserialize_arr(&arg, 1); }
 
+// vectors of simple types are copied in bulk
+  template<typename T, typename A>
+  void serialize_vec(const std::vector<T, A>& arg, std::true_type) noexcept
+    { serialize_arr(arg.data(), arg.size()); }
+
+  template<typename T, typename A>
+  void deserialize_vec(std::vector<T, A>& arg, std::true_type) noexcept
+  {
+    arg.resize(peek_length(sizeof(T)));
+    deserialize_arr(arg.data(), arg.size());
+  }
+
+  template<typename T, typename A>
+  void serialize_vec(const std::vector<T, A>& arg, std::false_type) noexcept
+    { serialize_seq(arg); }
+
+  template<typename T, typename A>
+  void deserialize_vec(std::vector<T, A>& arg, std::false_type) noexcept
+  {
+    arg.clear();
+    deserialize_seq(arg);
+  }
+
+  template<typename T, typename A>
+  void serialize(const std::vector<T, A>& arg) noexcept
+    { serialize_vec(arg, is_bulk_vector<T>()); }
+
+  template<typename T, typename A>
+  void deserialize(std::vector<T, A>& arg) noexcept
+    { deserialize_vec(arg, is_bulk_vector<T>()); }
 
 // multi-element STL containers
-  template<template<class> class T, class V>
-  void serialize(const T<V>& arg) noexcept
+  template<typename T>
+  void serialize_seq(const T& arg) noexcept
   {
-    if(std::is_integral<V>::value || std::is_floating_point<V>::value) // if contains a simple type
-      serialize_arr(arg);
-    else if(push<uint16_t>(UINT16_MAX) && // complex element type
-            push<uint16_t>(arg.size()))
+    if(push_header(Complex, arg.size()))
       for(const auto& element : arg) // NOTE: this is the most compatible way to iterate an STL container
         if(m_ok)
           serialize(element);
   }
 
-  template<template<class> class T, class V>
-  void deserialize(T<V>& arg) noexcept
+  template<typename T>
+  void deserialize_seq(T& arg) noexcept
   {
-    if(std::is_integral<V>::value || std::is_floating_point<V>::value) // if contains a simple type
-      deserialize_arr(arg);
-    else if(front<uint16_t>() == UINT16_MAX && // complex match
-            pull <uint16_t>())                 // no buffer underflow
+    posix::size_t length;
+    if(pull_header(Complex, length))
     {
-      V tmp;
-      for(uint16_t i = front<uint16_t>(); pull<V>() && i > 0; --i) // note: will skip empty containers
+      typename element<typename T::value_type>::type tmp;
+      for(; m_ok && length > 0; --length)
       {
         deserialize(tmp);
-        arg.emplace(tmp); // NOTE: this is the most compatible way to add element to an STL container
+        if(m_ok)
+          arg.insert(arg.end(), std::move(tmp)); // NOTE: this is the most compatible way to add element to an STL container
       }
     }
   }
 
+  template<template<class...> class T, class V, class... Rest>
+  void serialize(const T<V, Rest...>& arg) noexcept
+    { serialize_seq(arg); }
+
+  template<template<class...> class T, class V, class... Rest>
+  void deserialize(T<V, Rest...>& arg) noexcept
+    { deserialize_seq(arg); }
+
 // pair wrapper
   template<typename T, typename V>
   void serialize(const std::pair<T, V>& arg) noexcept
   {
-    if(push<uint16_t>(UINT16_MAX) && // complex element type
-       push<uint16_t>(2))
+    if(push_header(Complex, 2))
     {
       serialize(arg.first);
       serialize(arg.second);
@@ -209,10 +298,9 @@ private:
   template<typename T, typename V>
   void deserialize(std::pair<T, V>& arg) noexcept
   {
-    if(front<uint16_t>() == UINT16_MAX && // complex match
-       pull <uint16_t>() &&               // no buffer underflow
-       front<uint16_t>() == 2 &&          // pair length
-       pull <uint16_t>())
+    posix::size_t length;
+    if(pull_header(Complex, length) &&
+       length == 2) // pair length
     {
       deserialize(arg.first);
       deserialize(arg.second);
@@ -221,21 +309,21 @@ private:
 
 // string literals
   void serialize(const char* arg) noexcept
-    { serialize_arr(arg, uint16_t(posix::strlen(arg))); }
+    { serialize_arr(arg, posix::strlen(arg)); }
 
   void serialize(const wchar_t* arg) noexcept
-    { serialize_arr(arg, uint16_t(std::wcslen(arg))); }
+    { serialize_arr(arg, std::wcslen(arg)); }
 
 // string
-  template<typename T>
-  void deserialize(std::basic_string<T>& arg) noexcept
+  template<typename T, typename Traits, typename A>
+  void serialize(const std::basic_string<T, Traits, A>& arg) noexcept
+    { serialize_arr(arg.data(), arg.size()); }
+
+  template<typename T, typename Traits, typename A>
+  void deserialize(std::basic_string<T, Traits, A>& arg) noexcept
   {
-    arg.resize(data<uint16_t>()[1]);
-    deserialize_arr(const_cast<T*>(arg.data()), arg.size()); // not guaranteed to work per the STL spec but should never fail catastrophically.
+    arg.resize(peek_length(sizeof(T)));
+    deserialize_arr(&arg[0], arg.size());
   }
 };
-
-// make sure strings are read in properly!
-template<> vfifo& vfifo::operator << (const std::string& arg) noexcept;
-template<> vfifo& vfifo::operator << (const std::wstring& arg) noexcept;
 #endif // VQUEUE_H
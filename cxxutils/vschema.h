@@ -0,0 +1,281 @@
+#ifndef VSCHEMA_H
+#define VSCHEMA_H
+
+// STL
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vfifo.h>
+
+// describes one member of a message struct
+template<typename S, typename T, T S::*Member>
+struct vfield
+{
+  typedef T value_type;
+  static constexpr const T& get(const S& msg) noexcept { return msg.*Member; }
+  static T& get(S& msg) noexcept { return msg.*Member; }
+};
+
+#define VFIELD(S, member) vfield<S, decltype(S::member), &S::member>
+
+// combines a tag with the kind of an element so every level of nesting changes the result
+constexpr uint32_t vfield_mix(uint32_t tag, uint32_t kind) noexcept
+  { return (((2166136261U ^ tag) * 16777619U) ^ kind) * 16777619U; } // FNV-1a
+
+// encoding of a single field type
+// scalars live in the fixed-size prefix, arrays store a count there and their elements after the prefix
+template<typename T>
+struct vfield_traits
+{
+  static_assert(std::is_trivially_copyable<T>::value, "scalar fields must be trivially copyable");
+  static constexpr posix::size_t fixed(void) noexcept { return sizeof(T); }
+  static constexpr uint32_t kind(void) noexcept { return sizeof(T); }
+  static constexpr bool fits(const T&) noexcept { return true; }
+  static constexpr uint64_t variable(const T&) noexcept { return 0; }
+  static constexpr uint64_t variable(const uint8_t*) noexcept { return 0; }
+  static constexpr bool valid(const uint8_t*, const uint8_t*) noexcept { return true; }
+
+  static void encode(uint8_t*& prefix, uint8_t*&, const T& value) noexcept
+  {
+    posix::memcpy(prefix, &value, sizeof(T));
+    prefix += sizeof(T);
+  }
+
+  static void decode(const uint8_t*& prefix, const uint8_t*&, T& value) noexcept
+  {
+    posix::memcpy(&value, prefix, sizeof(T));
+    prefix += sizeof(T);
+  }
+};
+
+template<typename C, typename E>
+struct vfield_array_traits
+{
+  static_assert(std::is_trivially_copyable<E>::value && !std::is_same<E, bool>::value, "array fields must hold trivially copyable elements");
+  static constexpr posix::size_t fixed(void) noexcept { return sizeof(uint32_t); }
+  static constexpr uint32_t kind(void) noexcept { return 0x10000 | sizeof(E); }
+  static constexpr bool fits(const C& value) noexcept { return value.size() <= UINT32_MAX; }
+  static constexpr uint64_t variable(const C& value) noexcept { return uint64_t(value.size()) * sizeof(E); }
+
+  static uint64_t variable(const uint8_t* prefix) noexcept
+  {
+    uint32_t count;
+    posix::memcpy(&count, prefix, sizeof(uint32_t));
+    return uint64_t(count) * sizeof(E);
+  }
+
+  static constexpr bool valid(const uint8_t*, const uint8_t*) noexcept { return true; }
+
+  static void encode(uint8_t*& prefix, uint8_t*& payload, const C& value) noexcept
+  {
+    uint32_t count = uint32_t(value.size());
+    posix::memcpy(prefix, &count, sizeof(uint32_t));
+    prefix += sizeof(uint32_t);
+    if(count)
+      posix::memcpy(payload, &value[0], count * sizeof(E));
+    payload += count * sizeof(E);
+  }
+
+  static void decode(const uint8_t*& prefix, const uint8_t*& payload, C& value) noexcept
+  {
+    uint32_t count;
+    posix::memcpy(&count, prefix, sizeof(uint32_t));
+    prefix += sizeof(uint32_t);
+    value.resize(count);
+    if(count)
+      posix::memcpy(&value[0], payload, count * sizeof(E));
+    payload += count * sizeof(E);
+  }
+};
+
+// arrays of arrays store a count and their byte length in the prefix, each element is stored as [count][elements] after the prefix
+template<typename C, typename E>
+struct vfield_nested_traits
+{
+  typedef vfield_traits<E> inner;
+  static constexpr posix::size_t fixed(void) noexcept { return sizeof(uint32_t) * 2; }
+  static constexpr uint32_t kind(void) noexcept { return vfield_mix(0x20000, inner::kind()); }
+
+  static bool fits(const C& value) noexcept
+  {
+    if(value.size() > UINT32_MAX)
+      return false;
+    for(const E& element : value)
+      if(!inner::fits(element))
+        return false;
+    return variable(value) <= UINT32_MAX;
+  }
+
+  static uint64_t variable(const C& value) noexcept
+  {
+    uint64_t total = 0;
+    for(const E& element : value)
+      total += inner::fixed() + inner::variable(element);
+    return total;
+  }
+
+  static uint64_t variable(const uint8_t* prefix) noexcept
+  {
+    uint32_t bytes;
+    posix::memcpy(&bytes, prefix + sizeof(uint32_t), sizeof(uint32_t));
+    return bytes;
+  }
+
+  // the element counts are in the payload so they're checked against the field's byte length
+  static bool valid(const uint8_t* prefix, const uint8_t* payload) noexcept
+  {
+    uint32_t count;
+    posix::memcpy(&count, prefix, sizeof(uint32_t));
+    const uint8_t* end = payload + variable(prefix);
+    for(; count > 0; --count)
+    {
+      const uint8_t* element = payload;
+      if(posix::size_t(end - payload) < inner::fixed())
+        return false;
+      payload += inner::fixed();
+      if(uint64_t(end - payload) < inner::variable(element) ||
+         !inner::valid(element, payload))
+        return false;
+      payload += inner::variable(element);
+    }
+    return payload == end;
+  }
+
+  static void encode(uint8_t*& prefix, uint8_t*& payload, const C& value) noexcept
+  {
+    uint32_t count = uint32_t(value.size());
+    uint32_t bytes = uint32_t(variable(value));
+    posix::memcpy(prefix, &count, sizeof(uint32_t));
+    posix::memcpy(prefix + sizeof(uint32_t), &bytes, sizeof(uint32_t));
+    prefix += fixed();
+    for(const E& element : value)
+    {
+      uint8_t* element_prefix = payload;
+      payload += inner::fixed();
+      inner::encode(element_prefix, payload, element);
+    }
+  }
+
+  static void decode(const uint8_t*& prefix, const uint8_t*& payload, C& value) noexcept
+  {
+    uint32_t count;
+    posix::memcpy(&count, prefix, sizeof(uint32_t));
+    prefix += fixed();
+    value.resize(count);
+    for(E& element : value)
+    {
+      const uint8_t* element_prefix = payload;
+      payload += inner::fixed();
+      inner::decode(element_prefix, payload, element);
+    }
+  }
+};
+
+template<typename T, typename Traits, typename A>
+struct vfield_traits<std::basic_string<T, Traits, A>> : vfield_array_traits<std::basic_string<T, Traits, A>, T> { };
+
+template<typename T, typename A>
+struct vfield_traits<std::vector<T, A>>
+  : std::conditional<std::is_trivially_copyable<T>::value,
+                     vfield_array_traits<std::vector<T, A>, T>,
+                     vfield_nested_traits<std::vector<T, A>, T>>::type { };
+
+// message schema: encodes/decodes a whole struct at once
+// frame: [uint32_t signature][scalars and array counts in field order][array elements in field order]
+// fields may be vectors of strings or vectors (nested to any depth)
+//
+// struct hello_t { uint32_t id; std::string name; };
+// typedef vschema<hello_t, VFIELD(hello_t, id), VFIELD(hello_t, name)> hello_schema;
+template<typename S, typename... Fields>
+class vschema
+{
+  typedef std::initializer_list<int> expand; // evaluates a pack expansion in order
+
+  template<typename F>
+  using traits = vfield_traits<typename std::remove_cv<typename F::value_type>::type>;
+
+  static constexpr posix::size_t sum(void) noexcept { return 0; }
+  template<typename... Sizes>
+  static constexpr posix::size_t sum(posix::size_t first, Sizes... rest) noexcept { return first + sum(rest...); }
+
+  static constexpr uint32_t hash(uint32_t seed) noexcept { return seed; }
+  template<typename... Kinds>
+  static constexpr uint32_t hash(uint32_t seed, uint32_t first, Kinds... rest) noexcept
+    { return hash((seed ^ first) * 16777619U, rest...); } // FNV-1a
+
+public:
+  // bytes preceding the array elements
+  static constexpr posix::size_t prefixSize(void) noexcept
+    { return sizeof(uint32_t) + sum(traits<Fields>::fixed()...); }
+
+  // identifies the field layout so mismatched schemas are rejected
+  static constexpr uint32_t signature(void) noexcept
+    { return hash(2166136261U, uint32_t(sizeof...(Fields)), traits<Fields>::kind()...); }
+
+  static posix::size_t frameSize(const S& msg) noexcept
+  {
+    uint64_t total = prefixSize();
+    (void)expand { 0, (total += traits<Fields>::variable(Fields::get(msg)), 0)... };
+    return posix::size_t(total);
+  }
+
+  // appends msg to the buffer with a single allocation check
+  static bool encode(vfifo& buffer, const S& msg) noexcept
+  {
+    bool fits = true;
+    (void)expand { 0, (fits = fits && traits<Fields>::fits(Fields::get(msg)), 0)... };
+    if(!fits) // array is too long for a 32-bit count
+      return false;
+
+    posix::ssize_t total = posix::ssize_t(frameSize(msg));
+    if(buffer.unused() < total &&
+       !buffer.allocate(buffer.size() + total))
+      return false;
+
+    iovec span = buffer.writable();
+    if(posix::ssize_t(span.iov_len) < total)
+      return false;
+
+    uint8_t* prefix = static_cast<uint8_t*>(span.iov_base);
+    uint8_t* payload = prefix + prefixSize();
+    const uint32_t sig = signature();
+    posix::memcpy(prefix, &sig, sizeof(uint32_t));
+    prefix += sizeof(uint32_t);
+    (void)expand { 0, (traits<Fields>::encode(prefix, payload, Fields::get(msg)), 0)... };
+    return buffer.produce(total);
+  }
+
+  // validates the whole frame before decoding it into msg in a single pass
+  static bool decode(vfifo& buffer, S& msg) noexcept
+  {
+    if(buffer.size() < posix::ssize_t(prefixSize()))
+      return false;
+
+    const uint8_t* prefix = buffer.data<const uint8_t>();
+    uint32_t sig;
+    posix::memcpy(&sig, prefix, sizeof(uint32_t));
+    if(sig != signature())
+      return false;
+
+    uint64_t total = prefixSize();
+    bool valid = true;
+    const uint8_t* pos = prefix + sizeof(uint32_t);
+    (void)expand { 0, (valid = valid &&
+                               total + traits<Fields>::variable(pos) <= uint64_t(buffer.size()) &&
+                               traits<Fields>::valid(pos, prefix + total),
+                       total += traits<Fields>::variable(pos), pos += traits<Fields>::fixed(), 0)... };
+    if(!valid)
+      return false;
+
+    const uint8_t* payload = prefix + prefixSize();
+    prefix += sizeof(uint32_t);
+    (void)expand { 0, (traits<Fields>::decode(prefix, payload, Fields::get(msg)), 0)... };
+    return buffer.consume(posix::ssize_t(total));
+  }
+};
+
+#endif // VSCHEMA_H
@@ -44,10 +44,11 @@ QMAKE_CXXFLAGS_RELEASE += -DRELEASE
 #DEFINES += SINGLE_THREADED_APPLICATION
 #DEFINES += FORCE_POSIX_TIMERS
 #DEFINES += FORCE_POSIX_POLL
+#DEFINES += FORCE_EPOLL
 #DEFINES += FORCE_POSIX_MUTEXES
 #DEFINES += FORCE_PROCESS_POLLING
 
-#LIBS += -lpthread
+LIBS += -lpthread
 experimental {
 #QMAKE_CXXFLAGS += -stdlib=libc++
 QMAKE_CXXFLAGS += -nostdinc
@@ -0,0 +1,12 @@
+#include "object.h"
+
+void* Object::operator new(std::size_t size)
+{
+  return ::operator new(size); // the same allocator as the ::operator delete that frees it
+}
+
+void Object::operator delete(void* ptr) noexcept // ptr may not point to the ProtoObject (polymorphic objects start with a vtable pointer)
+{
+  Application::enqueue(ProtoObject::destroyed(), // free after queued calls on the event loop that owned the object (destructors just ran)
+                       [ptr](void) { ::operator delete(ptr); });
+}
@@ -3,19 +3,31 @@
 
 // PUT
 #include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/smallvector.h>
 #include <put/application.h>
 
 // STL
 #include <functional>
-#include <map>
 #include <new>
+#include <type_traits>
+#include <utility>
+
+#if !defined(SLOT_STORAGE_SIZE)
+#define SLOT_STORAGE_SIZE 16 // enough for a member function pointer or a lambda with two captures
+#endif
+
+#if !defined(SIGNAL_INLINE_SLOTS)
+#define SIGNAL_INLINE_SLOTS 4 // connections stored without allocation
+#endif
 
 struct ProtoObject
 {
-  inline  ProtoObject(void) noexcept : self(this) { } // make object valid
-  inline ~ProtoObject(void) noexcept { self = nullptr; } // invalidate object
+  inline  ProtoObject(void) noexcept : self(this), loop(Application::affinity()) { } // make object valid
+  inline ~ProtoObject(void) noexcept { self = nullptr; destroyed() = loop; } // invalidate object
   inline bool valid(void) const { return this == self; } // test object validity
+  static uint16_t& destroyed(void) noexcept { static thread_local uint16_t last = 0; return last; } // loop of the last object this thread destroyed
   void* self;
+  uint16_t loop; // event loop that executes this object's slots
 };
 
 
@@ -31,77 +43,258 @@ public:
   template<typename RType, typename... ArgTypes>
   using fpslot_t = RType(*)(ArgTypes...); // function pointer slot
 
+  enum ConnectionType : uint8_t
+  {
+    QueuedConnection = 0, // slot is called from the event loop that owns the object
+    DirectConnection = 1, // slot is called during emission when on the event loop that owns the object (it may delete the emitter: later slots are then skipped)
+  };
+
   template<typename... ArgTypes>
-  class signal : private std::multimap<ProtoObject*, fslot_t<void, ProtoObject*, ArgTypes...>>
+  class signal
   {
   public:
-    typedef std::multimap<ProtoObject*, fslot_t<void, ProtoObject*, ArgTypes...>> storage_t;
+    class slot_t // copyable callable that stores small function objects inline (no allocation)
+    {
+      typedef typename std::aligned_storage<SLOT_STORAGE_SIZE, alignof(void*)>::type storage_t;
+      typedef std::integral_constant<bool, true > stored_inline;
+      typedef std::integral_constant<bool, false> stored_on_heap;
+      enum operation_t { Copy, Move, Destroy };
+
+    public:
+      template<typename Func>
+      slot_t(ProtoObject* obj, ConnectionType type, Func&& function) noexcept
+        : m_object(obj), m_type(type), m_connected(true), m_heap(false)
+      {
+        typedef typename std::decay<Func>::type func_type;
+        construct<func_type>(std::forward<Func>(function),
+                             std::integral_constant<bool, sizeof(func_type) <= SLOT_STORAGE_SIZE &&
+                                                          alignof(void*) % alignof(func_type) == 0>());
+      }
+
+      slot_t(const slot_t& other) noexcept
+        : m_object(other.m_object), m_type(other.m_type), m_connected(other.m_connected), m_heap(other.m_heap),
+          m_invoke(other.m_invoke), m_manage(other.m_manage)
+      {
+        if(m_manage == nullptr) // trivially copyable
+          m_storage = other.m_storage;
+        else
+          m_manage(Copy, &m_storage, const_cast<storage_t*>(&other.m_storage));
+      }
+
+      slot_t(slot_t&& other) noexcept
+        : m_object(other.m_object), m_type(other.m_type), m_connected(other.m_connected), m_heap(other.m_heap),
+          m_invoke(other.m_invoke), m_manage(other.m_manage)
+      {
+        if(m_manage == nullptr) // trivially copyable
+          m_storage = other.m_storage;
+        else
+          m_manage(Move, &m_storage, &other.m_storage);
+      }
+
+      ~slot_t(void) noexcept
+      {
+        if(m_manage != nullptr)
+          m_manage(Destroy, &m_storage, nullptr);
+      }
+
+      slot_t& operator=(const slot_t& other) noexcept
+      {
+        if(this != &other)
+        {
+          this->~slot_t();
+          new (this) slot_t(other);
+        }
+        return *this;
+      }
+
+      slot_t& operator=(slot_t&& other) noexcept
+      {
+        if(this != &other)
+        {
+          this->~slot_t();
+          new (this) slot_t(std::move(other));
+        }
+        return *this;
+      }
+
+      ProtoObject* object(void) const noexcept { return m_object; }
+      bool direct(void) const noexcept { return m_type == DirectConnection; }
+      bool valid(void) const noexcept { return m_connected && (m_object == nullptr || m_object->valid()); } // IF no object OR object is valid
+      void disconnect(void) noexcept { m_connected = false; }
+      bool stable(void) const noexcept { return m_heap; } // function object keeps its address when the slot is moved
+      uint16_t loop(void) const noexcept // event loop that owns the object
+        { return m_object == nullptr ? Application::affinity() : m_object->loop; }
 
-//    inline  signal(void) noexcept = default;
-//    inline ~signal(void) noexcept = default;
+      void operator()(ArgTypes&... args) noexcept { m_invoke(&m_storage, m_object, args...); }
+
+    private:
+      template<typename T, typename Func>
+      void construct(Func&& function, stored_inline) noexcept
+      {
+        new (&m_storage) T(std::forward<Func>(function));
+        m_invoke = [](void* storage, ProtoObject* p, ArgTypes&... args) noexcept
+          { (*static_cast<T*>(storage))(p, args...); };
+        m_manage = [](operation_t op, void* dest, void* src) noexcept
+          {
+            switch(op)
+            {
+              case Copy   : new (dest) T(*static_cast<T*>(src)); break;
+              case Move   : new (dest) T(std::move(*static_cast<T*>(src))); break;
+              case Destroy: static_cast<T*>(dest)->~T(); break;
+            }
+          };
+        if(std::is_trivially_copyable<T>::value) // copy storage directly
+          m_manage = nullptr;
+      }
+
+      template<typename T, typename Func>
+      void construct(Func&& function, stored_on_heap) noexcept // function object is too large
+      {
+        *reinterpret_cast<T**>(&m_storage) = new T(std::forward<Func>(function));
+        m_heap = true;
+        m_invoke = [](void* storage, ProtoObject* p, ArgTypes&... args) noexcept
+          { (**static_cast<T**>(storage))(p, args...); };
+        m_manage = [](operation_t op, void* dest, void* src) noexcept
+          {
+            switch(op)
+            {
+              case Copy   : *static_cast<T**>(dest) = new T(**static_cast<T**>(src)); break;
+              case Move   : *static_cast<T**>(dest) = *static_cast<T**>(src); *static_cast<T**>(src) = nullptr; break;
+              case Destroy: delete *static_cast<T**>(dest); break;
+            }
+          };
+      }
+
+      storage_t m_storage;
+      ProtoObject* m_object;
+      ConnectionType m_type;
+      bool m_connected;
+      bool m_heap; // function object is stored on the heap
+      void (*m_invoke)(void*, ProtoObject*, ArgTypes&...) noexcept;
+      void (*m_manage)(operation_t, void*, void*) noexcept; // nullptr when trivially copyable
+    };
+
+    typedef smallvector<slot_t, SIGNAL_INLINE_SLOTS> storage_t;
+
+    inline  signal(void) noexcept : m_emitting(0), m_prune(false), m_emission(nullptr) { }
+    inline ~signal(void) noexcept
+    {
+      for(emission_t* emission = m_emission; emission != nullptr; emission = emission->outer)
+        emission->destroyed = true; // a direct slot destroyed the signal (and the object that owns it)
+    }
 
     bool invocation(ArgTypes&... args) noexcept
     {
-      if(!storage_t::empty() &&  // ensure that invalid signals are ignored
-         Application::ms_signal_queue.lock()) // multithread protection
+      if(m_slots.empty()) // ensure that invalid signals are ignored
+        return false;
+
+      bool rval = true;
+      emission_t emission = { m_emission, false };
+      m_emission = &emission;
+      ++m_emitting; // slots are only marked as disconnected while emitting
+      for(posix::size_t pos = 0, count = m_slots.size(); pos < count; ++pos) // will iterate through all slots connected before emission
       {
-        for(typename storage_t::iterator pos = storage_t::begin(); pos != storage_t::end(); ) // will iterate through all connected slots
+        slot_t& slot = m_slots[pos];
+        if(!slot.valid()) // IF disconnected OR has object AND object is invalid
+          m_prune = true;
+        else if(slot.direct() && slot.loop() == Application::affinity()) // IF direct AND on the event loop that owns the object
         {
-          if(pos->first == nullptr || pos->first->valid()) // IF no object OR object is valid
+          if(slot.stable()) // heap function objects survive m_slots growing during the call
+            slot(args...);
+          else
           {
-            Application::ms_signal_queue.emplace(std::bind(pos->second, pos->first, std::forward<ArgTypes>(args)...));
-            ++pos; // iterate
+            slot_t copy(slot); // the slot may connect slots to this signal (inline copies don't allocate)
+            copy(args...);
           }
-          else // IF has object AND object is invalid
-            pos = storage_t::erase(pos); // erase and iterate
+          if(emission.destroyed) // nothing of the signal may be touched (arguments may have been members too)
+            return rval;
         }
+        else
+          rval &= Application::enqueue(slot.loop(), // queue on the event loop that owns the object
+                                       [slot, args...](void) mutable noexcept { slot(args...); }); // copies of arguments for each slot
+      }
 
-        Application::step(); // inform execution stepper
-        return Application::ms_signal_queue.unlock();
+      m_emission = emission.outer;
+      if(!--m_emitting && m_prune) // erase every dead slot at once
+      {
+        m_slots.remove_if([](const slot_t& slot) noexcept { return !slot.valid(); });
+        m_prune = false;
       }
-      return false;
+      return rval;
     }
 
     // connect to a member of an object
     template<class ObjType, typename RType>
-    inline void connect(ObjType* obj, mslot_t<ObjType, RType, ArgTypes...> slot) noexcept
+    inline void connect(ObjType* obj, mslot_t<ObjType, RType, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
     {
-      storage_t::emplace(static_cast<ProtoObject*>(obj),
-        [slot](ProtoObject* p, ArgTypes... args) noexcept
+      m_slots.emplace_back(static_cast<ProtoObject*>(obj), type,
+        [slot](ProtoObject* p, ArgTypes&... args) noexcept
           { if(p->valid()) (static_cast<ObjType*>(p)->*slot)(args...); }); // if ProtoObject is valid (not deleted), call slot
     }
 
     // connect to a function that accept the object pointer as the first argument
     template<class ObjType, typename RType>
-    inline void connect(ObjType* obj, fslot_t<RType, ObjType*, ArgTypes...> slot) noexcept
+    inline void connect(ObjType* obj, fslot_t<RType, ObjType*, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
     {
-      storage_t::emplace(static_cast<ProtoObject*>(obj),
-        [slot](ProtoObject* p, ArgTypes... args) noexcept
+      m_slots.emplace_back(static_cast<ProtoObject*>(obj), type,
+        [slot](ProtoObject* p, ArgTypes&... args) noexcept
           { if(p->valid()) slot(static_cast<ObjType*>(p), args...); }); // if ProtoObject is valid (not deleted), call slot
     }
 
-    // connect to a function and ignore the object
-    template<typename RType>
-    inline void connect(fslot_t<RType, ArgTypes...> slot) noexcept
+    // connect to a function object (lambda, function pointer or fslot_t) and ignore the object
+    template<typename Func>
+    inline void connect(Func slot, ConnectionType type = QueuedConnection) noexcept
     {
-      storage_t::emplace(nullptr,
-        [slot](ProtoObject*, ArgTypes... args) noexcept
+      m_slots.emplace_back(nullptr, type,
+        [slot](ProtoObject*, ArgTypes&... args) mutable noexcept
           { slot(args...); });
     }
 
     // connect to another signal
-    inline void connect(signal<ArgTypes...>& other) noexcept
+    inline void connect(signal<ArgTypes...>& other, ConnectionType type = QueuedConnection) noexcept
     {
-      storage_t::emplace(nullptr,
-        [&other](ProtoObject*, ArgTypes... args) noexcept
+      m_slots.emplace_back(nullptr, type,
+        [&other](ProtoObject*, ArgTypes&... args) noexcept
           { other.invocation(args...); });
     }
 
     inline void disconnect(Object* obj) noexcept
-      { storage_t::erase(obj); }
+    {
+      ProtoObject* p = obj;
+      if(m_emitting) // slots may be executing
+      {
+        for(slot_t& slot : m_slots)
+          if(slot.object() == p)
+            slot.disconnect();
+        m_prune = true;
+      }
+      else
+        m_slots.remove_if([p](const slot_t& slot) noexcept { return slot.object() == p; });
+    }
 
     inline void disconnect(void) noexcept
-      { storage_t::clear(); }
+    {
+      if(m_emitting) // slots may be executing
+      {
+        for(slot_t& slot : m_slots)
+          slot.disconnect();
+        m_prune = true;
+      }
+      else
+        m_slots.clear();
+    }
+
+  private:
+    struct emission_t // lives on the stack of invocation()
+    {
+      emission_t* outer; // emission in progress when this one started
+      bool destroyed;
+    };
+
+    storage_t m_slots;
+    uint32_t m_emitting; // depth of (recursive) emissions in progress
+    bool m_prune; // slots need to be erased
+    emission_t* m_emission; // innermost emission in progress
   };
 
 
@@ -110,36 +303,36 @@ public:
 
   // connect to a member of an object
   template<class ObjType, typename RType, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, mslot_t<ObjType, RType, ArgTypes...> slot) noexcept
-    { sig.connect(obj, slot); }
+  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, mslot_t<ObjType, RType, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(obj, slot, type); }
 
   // connect to another signal
   template<typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig1, signal<ArgTypes...>& sig2) noexcept
-    { sig1.connect(sig2); }
+  static inline void connect(signal<ArgTypes...>& sig1, signal<ArgTypes...>& sig2, ConnectionType type = QueuedConnection) noexcept
+    { sig1.connect(sig2, type); }
 
   // connect to a function that accept the object pointer as the first argument
   template<class ObjType, typename RType, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, fslot_t<RType, ObjType*, ArgTypes...> slot) noexcept
-    { sig.connect(obj, slot); }
+  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, fslot_t<RType, ObjType*, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(obj, slot, type); }
 
   template<class ObjType, typename RType, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, fpslot_t<RType, ObjType*, ArgTypes...> slot) noexcept
-    { sig.connect(obj, fslot_t<RType, ArgTypes...>(slot)); }
+  static inline void connect(signal<ArgTypes...>& sig, ObjType* obj, fpslot_t<RType, ObjType*, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(obj, fslot_t<RType, ArgTypes...>(slot), type); }
 
   // connect to a lambda function
   template<typename Lambda, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, Lambda&& slot) noexcept
-    { sig.connect(fslot_t<void, ArgTypes...>(slot)); }
+  static inline void connect(signal<ArgTypes...>& sig, Lambda&& slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(std::forward<Lambda>(slot), type); }
 
   // connect to a function and ignore the object
   template<typename RType, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, fslot_t<RType, ArgTypes...> slot) noexcept
-    { sig.connect(slot); }
+  static inline void connect(signal<ArgTypes...>& sig, fslot_t<RType, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(slot, type); }
 
   template<typename RType, typename... ArgTypes>
-  static inline void connect(signal<ArgTypes...>& sig, fpslot_t<RType, ArgTypes...> slot) noexcept
-    { sig.connect(fslot_t<RType, ArgTypes...>(slot)); }
+  static inline void connect(signal<ArgTypes...>& sig, fpslot_t<RType, ArgTypes...> slot, ConnectionType type = QueuedConnection) noexcept
+    { sig.connect(fslot_t<RType, ArgTypes...>(slot), type); }
 
   // disconnect all connections from signal
   template<typename... ArgTypes>
@@ -155,27 +348,14 @@ public:
   template<class ObjType, typename RType, typename... ArgTypes>
   static inline bool singleShot(ObjType* obj, mslot_t<ObjType, RType, ArgTypes...> slot, ArgTypes&... args) noexcept
   {
-    if(obj->valid() && // ensure object is valid
-       Application::ms_signal_queue.lock()) // multithread protection
-    {
-      Application::ms_signal_queue.emplace(std::bind(slot, obj, std::forward<ArgTypes>(args)...));
-      Application::step(); // inform execution stepper
-      return Application::ms_signal_queue.unlock();
-    }
-    return false;
+    return obj->valid() && // ensure object is valid
+           Application::enqueue(static_cast<ProtoObject*>(obj)->loop, // queue on the event loop that owns the object
+                                std::bind(slot, obj, args...));
   }
 
   template<typename RType, template<typename, typename...> class FuncType, typename... ArgTypes>
   static inline bool singleShot(FuncType<RType, ArgTypes...> slot, ArgTypes&... args) noexcept
-  {
-    if(Application::ms_signal_queue.lock()) // multithread protection
-    {
-      Application::ms_signal_queue.emplace(std::bind(slot, std::forward<ArgTypes>(args)...));
-      Application::step(); // inform execution stepper
-      return Application::ms_signal_queue.unlock();
-    }
-    return false;
-  }
+    { return Application::enqueue(Application::affinity(), std::bind(slot, args...)); }
 
   // enqueue a call to the functions connected to the signal with /copies/ of the arguments
   template<template<typename, typename...> class FuncType, typename... ArgTypes>
@@ -196,15 +376,9 @@ public:
   static inline bool enqueue_copy(signal<ArgTypes...>& sig, ArgTypes... args) noexcept
     { return sig.invocation(args...);}
 
-  void operator delete(void* ptr) noexcept
-  {
-    static_cast<ProtoObject*>(ptr)->self = nullptr; // invalidate object
-    if(Application::ms_signal_queue.lock()) // multithread protection
-    {
-      Application::ms_signal_queue.emplace([ptr](void) { ::operator delete(ptr); });
-      Application::ms_signal_queue.unlock();
-    }
-  }
+  // defined out of line so new and delete expressions see the same pair of allocation functions
+  void* operator new(std::size_t size);
+  void operator delete(void* ptr) noexcept; // freed after the queued calls of the object
 };
 
 #endif // OBJECT_H
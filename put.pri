@@ -8,6 +8,7 @@ HEADERS += \
     $$PUTPATH/application.h \
     $$PUTPATH/childprocess.h \
     $$PUTPATH/object.h \
+    $$PUTPATH/rpc.h \
     $$PUTPATH/socket.h \
     $$PUTPATH/cxxutils/configmanip.h \
     $$PUTPATH/cxxutils/cstringarray.h \
@@ -15,16 +16,20 @@ HEADERS += \
     $$PUTPATH/cxxutils/hashing.h \
     $$PUTPATH/cxxutils/pipedspawn.h \
     $$PUTPATH/cxxutils/misc_helpers.h \
+    $$PUTPATH/cxxutils/mpscqueue.h \
     $$PUTPATH/cxxutils/posix_helpers.h \
     $$PUTPATH/cxxutils/socket_helpers.h \
     $$PUTPATH/cxxutils/syslogstream.h \
+    $$PUTPATH/cxxutils/task.h \
     $$PUTPATH/cxxutils/nullable.h \
     $$PUTPATH/cxxutils/sharedmem.h \
     $$PUTPATH/cxxutils/pipedfork.h \
     $$PUTPATH/cxxutils/signal_helpers.h \
+    $$PUTPATH/cxxutils/smallvector.h \
     $$PUTPATH/cxxutils/stringtoken.h \
     $$PUTPATH/cxxutils/translate.h \
     $$PUTPATH/cxxutils/vfifo.h \
+    $$PUTPATH/cxxutils/vschema.h \
     $$PUTPATH/cxxutils/vterm.h \
     $$PUTPATH/specialized/blockdevices.h \
     $$PUTPATH/specialized/blockinfo.h \
@@ -43,6 +48,7 @@ HEADERS += \
     $$PUTPATH/specialized/peercred.h \
     $$PUTPATH/specialized/processevent.h \
     $$PUTPATH/specialized/procstat.h \
+    $$PUTPATH/specialized/processtable.h \
     $$PUTPATH/specialized/timerevent.h
 
 tui:HEADERS += \
@@ -60,6 +66,8 @@ tui:HEADERS += \
 SOURCES += \
     $$PUTPATH/application.cpp \
     $$PUTPATH/childprocess.cpp \
+    $$PUTPATH/object.cpp \
+    $$PUTPATH/rpc.cpp \
     $$PUTPATH/socket.cpp \
     $$PUTPATH/cxxutils/configmanip.cpp \
     $$PUTPATH/cxxutils/stringtoken.cpp \
@@ -81,6 +89,7 @@ SOURCES += \
     $$PUTPATH/specialized/peercred.cpp \
     $$PUTPATH/specialized/processevent.cpp \
     $$PUTPATH/specialized/procstat.cpp \
+    $$PUTPATH/specialized/processtable.cpp \
     $$PUTPATH/specialized/timerevent.cpp
 
 tui:SOURCES += \
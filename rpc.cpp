@@ -0,0 +1,134 @@
+#include "rpc.h"
+
+// PUT
+#include <put/cxxutils/vterm.h>
+
+static bool extract_id(vfifo& message, uint32_t& id) noexcept
+{
+  if(message.size() < posix::ssize_t(sizeof(uint32_t)))
+    return false;
+  posix::memcpy(&id, message.data(), sizeof(id));
+  id = ntohl(id);
+  return true;
+}
+
+// RpcClient
+
+RpcClient::RpcClient(EDomain domain, EType type, EProtocol protocol, Flags_t mode) noexcept
+  : RpcClient(posix::socket(domain, type, protocol), mode) { }
+
+RpcClient::RpcClient(posix::fd_t socket, Flags_t mode) noexcept
+  : ClientSocket(socket, mode), m_sequence(0)
+{
+  Object::connect(newMessage, this, &RpcClient::receive, DirectConnection); // replies are handled as soon as they're read
+  Object::connect(disconnected, this, &RpcClient::lost, DirectConnection);
+}
+
+RpcClient::~RpcClient(void) noexcept
+{
+  Object::disconnect(disconnected, this); // GenericSocket emits it after this is destroyed
+  fail();
+}
+
+bool RpcClient::call(const vfifo& request, reply_t reply) noexcept
+{
+  uint32_t index;
+  if(!m_free.empty()) // reuse an index
+  {
+    index = m_free.back();
+    m_free.pop_back();
+  }
+  else
+  {
+    flaw(m_requests.size() > IndexMask,
+         terminal::warning,,
+         false,
+         "Too many pending requests (%lu)", m_requests.size())
+    index = uint32_t(m_requests.size());
+    m_requests.push_back(request_t { 0, nullptr });
+  }
+
+  if(!(++m_sequence << IndexBits)) // id can't be 0
+    ++m_sequence;
+  uint32_t id = (m_sequence << IndexBits) | index;
+
+  if(!writeTagged(id, request))
+  {
+    m_free.push_back(index);
+    return false;
+  }
+
+  m_requests[index].id = id;
+  m_requests[index].reply = std::move(reply);
+  return true;
+}
+
+void RpcClient::receive(posix::fd_t socket, vfifo message, posix::fd_t passfd) noexcept
+{
+  (void)socket;
+  if(passfd != posix::invalid_descriptor) // not part of the protocol
+    posix::close(passfd);
+
+  uint32_t id;
+  flaw(!extract_id(message, id),
+       terminal::warning,,,
+       "Received a malformed reply (%li bytes)", message.size())
+
+  uint32_t index = id & IndexMask;
+  flaw(index >= m_requests.size() || m_requests[index].id != id,
+       terminal::warning,,,
+       "Received a reply to an unknown request (id: %08x)", id)
+
+  reply_t reply = std::move(m_requests[index].reply);
+  m_requests[index].id = 0;
+  m_free.push_back(index);
+
+  vfifo response = message.view(sizeof(uint32_t), message.size() - posix::ssize_t(sizeof(uint32_t))); // no copy
+  reply(true, response);
+}
+
+void RpcClient::lost(posix::fd_t socket) noexcept
+{
+  (void)socket;
+  fail();
+}
+
+void RpcClient::fail(void) noexcept
+{
+  vfifo empty(0);
+  for(uint32_t index = 0; index < m_requests.size(); ++index)
+  {
+    if(m_requests[index].id)
+    {
+      reply_t reply = std::move(m_requests[index].reply);
+      m_requests[index].id = 0;
+      m_free.push_back(index);
+      reply(false, empty);
+    }
+  }
+}
+
+// RpcServer
+
+RpcServer::RpcServer(EDomain domain, EType type, EProtocol protocol, Flags_t mode) noexcept
+  : RpcServer(posix::socket(domain, type, protocol), mode) { }
+
+RpcServer::RpcServer(posix::fd_t socket, Flags_t mode) noexcept
+  : ServerSocket(socket, mode)
+{
+  Object::connect(newPeerMessage, this, &RpcServer::receive, DirectConnection); // requests are parsed as soon as they're read
+}
+
+void RpcServer::receive(posix::fd_t socket, vfifo message, posix::fd_t passfd) noexcept
+{
+  if(passfd != posix::invalid_descriptor) // not part of the protocol
+    posix::close(passfd);
+
+  uint32_t id;
+  flaw(!extract_id(message, id),
+       terminal::warning,,,
+       "Received a malformed request (%li bytes)", message.size())
+
+  vfifo payload = message.view(sizeof(uint32_t), message.size() - posix::ssize_t(sizeof(uint32_t))); // no copy
+  Object::enqueue(request, socket, id, payload);
+}
@@ -0,0 +1,70 @@
+#ifndef RPC_H
+#define RPC_H
+
+// STL
+#include <functional>
+#include <vector>
+
+// PUT
+#include <put/socket.h>
+
+// requests and replies are socket messages tagged with a request id
+// many requests can be pending on a connection and replies may arrive in any order
+
+class RpcClient : public ClientSocket
+{
+public:
+  using reply_t = std::function<void(bool, vfifo&) noexcept>; // false when the connection was lost before a reply
+
+  RpcClient(EDomain   domain   = EDomain::local,
+            EType     type     = EType::stream,
+            EProtocol protocol = EProtocol::unspec,
+            Flags_t   mode     = Invalid) noexcept;
+  RpcClient(posix::fd_t socket, Flags_t mode = Invalid) noexcept;
+  ~RpcClient(void) noexcept;
+
+  bool call(const vfifo& request, reply_t reply) noexcept; // queues a request (reply is called once)
+  posix::size_t pending(void) const noexcept { return m_requests.size() - m_free.size(); }
+
+private:
+  enum : uint32_t
+  {
+    IndexBits = 16, // request ids are an index in the low bits and a sequence number in the high bits
+    IndexMask = (1 << IndexBits) - 1,
+  };
+
+  struct request_t
+  {
+    uint32_t id; // 0 while unused
+    reply_t reply;
+  };
+
+  void receive(posix::fd_t socket, vfifo message, posix::fd_t passfd) noexcept;
+  void lost(posix::fd_t socket) noexcept;
+  void fail(void) noexcept; // fail every pending request
+
+  std::vector<request_t> m_requests; // indexed by the low bits of the request id
+  std::vector<uint32_t> m_free; // unused indexes
+  uint32_t m_sequence;
+};
+
+class RpcServer : public ServerSocket
+{
+public:
+  RpcServer(EDomain   domain   = EDomain::local,
+            EType     type     = EType::stream,
+            EProtocol protocol = EProtocol::unspec,
+            Flags_t   mode     = Invalid) noexcept;
+  RpcServer(posix::fd_t socket, Flags_t mode = Invalid) noexcept;
+
+  // replies written in the same pass of the event loop are sent together
+  bool reply(posix::fd_t socket, uint32_t id, const vfifo& response) noexcept
+    { return writeTagged(socket, id, response); }
+
+  signal<posix::fd_t, uint32_t, vfifo> request; // request received from peer (reply with the same id)
+
+private:
+  void receive(posix::fd_t socket, vfifo message, posix::fd_t passfd) noexcept;
+};
+
+#endif // RPC_H
@@ -1,5 +1,8 @@
 #include "socket.h"
 
+// STL
+#include <algorithm>
+
 // PUT
 #include <put/cxxutils/posix_helpers.h>
 #include <put/cxxutils/vterm.h>
@@ -8,21 +11,37 @@
 
 GenericSocket::GenericSocket(EDomain   domain,
                              EType     type,
-                             EProtocol protocol) noexcept
-  : GenericSocket(posix::socket(domain, type, protocol)) { }
+                             EProtocol protocol,
+                             Flags_t   mode) noexcept
+  : GenericSocket(posix::socket(domain, type, protocol), mode) { }
 
-GenericSocket::GenericSocket(posix::fd_t socket) noexcept
-  : PollEvent(socket, Readable | Disconnected),
+GenericSocket::GenericSocket(posix::fd_t socket, Flags_t mode) noexcept
+  : PollEvent(socket, Readable | Disconnected | (mode & (EdgeTriggered | OneShot | Exclusive))),
     m_connected(false), m_socket(socket)
 {
+  m_sockaddr = EDomain::unspec; // nothing to unlink
+  if(m_flags.EdgeTriggered)
+    posix::donotblock(m_socket); // reads must be able to drain the socket
+
   Object::connect(PollEvent::activated,
                     [this](posix::fd_t l_socket, Flags_t l_flags) noexcept
                     {
+                      if(m_connecting && (l_flags.Error || l_flags.Disconnected))
+                        l_flags.Writeable = 1; // flush() reports the failed connection attempt
                       if(l_flags & Readable)
-                        read(l_socket, Readable);
-                      if(l_flags & Disconnected)
+                      {
+                        if(m_flags.EdgeTriggered) // won't be activated again until drained
+                          while(m_socket == l_socket && read(l_socket, Readable));
+                        else
+                          read(l_socket, Readable);
+                      }
+                      if(l_flags & Writeable)
+                        flush();
+                      if((l_flags & Disconnected) && m_socket == l_socket) // not already disconnected
                         Object::enqueue(disconnected, l_socket);
-                    });
+                      else if(m_flags.OneShot && m_socket == l_socket) // handled: report the socket again
+                        rearm();
+                    }, DirectConnection); // read as soon as the backend reports the socket
 }
 
 GenericSocket::~GenericSocket(void) noexcept { disconnect(); }
@@ -46,6 +65,15 @@ void GenericSocket::disconnect(void) noexcept
   m_connected = false;
 }
 
+EDomain GenericSocket::domain(void) const noexcept
+{
+  posix::sockaddr_t addr;
+  socklen_t addrlen = sizeof(sockaddr_un);
+  if(::getsockname(m_socket, addr, &addrlen) != posix::success_response)
+    return EDomain::unspec;
+  return addr;
+}
+
 // ClientSocket
 
 bool ClientSocket::connect(const char *socket_path) noexcept
@@ -87,39 +115,343 @@ bool ClientSocket::connect(const char *socket_path) noexcept
   return true;
 }
 
-bool ClientSocket::write(const vfifo& buffer, posix::fd_t passfd) const noexcept
+bool ClientSocket::connect(const char* address, in_port_t port) noexcept
 {
-  msghdr header = {};
-  iovec iov = {};
-  char* aux_buffer = static_cast<char*>(posix::malloc(CMSG_SPACE(sizeof(int))));
-  if(aux_buffer == NULL)
+  posix::sockaddr_t peeraddr;
+  flaw(!peeraddr.setAddress(address, port),
+       terminal::warning,,
+       false,
+       "\"%s\" is not a numeric IPv4 or IPv6 address", address)
+  return connectAsync(peeraddr, ConnectTimeout); // the handshake is finished by flush() so the event loop never waits for it
+}
+
+bool ClientSocket::setNoDelay(bool enable) noexcept
+{
+  flaw(!posix::setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, enable ? 1 : 0),
+       terminal::warning,,
+       false,
+       "Unable to set TCP_NODELAY: %s", posix::strerror(errno))
+  return true;
+}
+
+bool ClientSocket::setFastOpen(bool enable) noexcept
+{
+#if defined(TCP_FASTOPEN_CONNECT) /* Linux 4.11+ */
+  flaw(!posix::setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, enable ? 1 : 0),
+       terminal::warning,,
+       false,
+       "Unable to set TCP_FASTOPEN_CONNECT: %s", posix::strerror(errno))
+  return true;
+#else
+  return !enable;
+#endif
+}
+
+bool ClientSocket::connectAsync(const posix::sockaddr_t& peer, milliseconds_t timeout) noexcept
+{
+  flaw(m_connected || m_connecting,
+       terminal::warning,,
+       false,
+       "Client socket is already connected!")
+
+  flaw(m_socket == posix::invalid_descriptor,
+       terminal::warning,,
+       false,
+       "Unable to connect a closed socket")
+
+  flaw(peer == EDomain::local && posix::strlen(peer.sun_path) >= sizeof(sockaddr_un::sun_path),
+       terminal::warning,,
+       false,
+       "socket_path exceeds the maximum path length (%lu characters)", sizeof(sockaddr_un::sun_path))
+
+  m_sockaddr = EDomain::unspec;
+  posix::donotblock(m_socket); // connect() must not wait
+
+  if(!posix::connect(m_socket, peer, socklen_t(peer.size())) &&
+     errno != EINPROGRESS)
+  {
+    connectFailure(errno);
     return false;
+  }
 
-  header.msg_iov = &iov;
-  header.msg_iovlen = 1;
-  header.msg_control = aux_buffer;
+  m_connecting = true; // finished by flush() when the socket is writeable
+  if(timeout > 0)
+  {
+    if(m_deadline == nullptr)
+    {
+      m_deadline = new TimerEvent();
+      Object::connect(m_deadline->expired, this, &ClientSocket::connectTimeout);
+    }
+    m_deadline->start(timeout);
+  }
+
+  if(!m_flags.Writeable)
+    setFlags(m_flags | Writeable);
+  return true;
+}
 
-  iov.iov_base = buffer.begin();
-  //iov.iov_len = CMSG_SPACE(sizeof(int));
-  iov.iov_len = buffer.size(); // ???
+bool ClientSocket::established(void) noexcept
+{
+  posix::error_t error = posix::success_response;
+  socklen_t length = sizeof(error);
+  if(::getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &error, &length) != posix::success_response)
+    error = errno;
+
+  posix::sockaddr_t peeraddr;
+  socklen_t addrlen = sizeof(sockaddr_un);
+  posix::memset(&peeraddr, 0, sizeof(peeraddr));
+  if(error == posix::success_response &&
+     ::getpeername(m_socket, peeraddr, &addrlen) != posix::success_response)
+  {
+    if(errno == ENOTCONN) // still in progress
+      return false;
+    error = errno;
+  }
 
-  header.msg_controllen = 0;
+  proccred_t cred = { pid_t(-1), uid_t(-1), gid_t(-1) }; // unavailable for network peers
+  if(error == posix::success_response &&
+     peeraddr == EDomain::local &&
+     (!::send_cred(m_socket) || !::recv_cred(m_socket, cred)))
+    error = errno;
 
-  if(passfd != posix::invalid_descriptor) // if a file descriptor needs to be sent
+  if(error != posix::success_response)
   {
-    header.msg_controllen = CMSG_SPACE(sizeof(int));
-    cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type = SCM_RIGHTS;
-    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
-    *reinterpret_cast<int*>(CMSG_DATA(cmsg)) = passfd;
+    connectFailure(error);
+    return false;
   }
 
-  flaw(posix::sendmsg(m_socket, &header) == posix::error_response,
+  m_connecting = false;
+  m_connected = true;
+  if(m_deadline != nullptr)
+    m_deadline->stop();
+  Object::enqueue(connected, m_socket, peeraddr, cred);
+  return true;
+}
+
+void ClientSocket::connectFailure(posix::error_t error) noexcept
+{
+  m_connecting = false;
+  if(m_deadline != nullptr)
+    m_deadline->stop();
+  Object::enqueue_copy(connectFailed, m_socket, error);
+  disconnect();
+}
+
+void ClientSocket::connectTimeout(void) noexcept
+{
+  if(m_connecting) // the timer may have expired as the connection was established
+    connectFailure(posix::error_t(posix::errc::timed_out));
+}
+
+ClientSocket::~ClientSocket(void) noexcept
+{
+  if(m_deadline != nullptr)
+    delete m_deadline;
+  if(m_passfd != posix::invalid_descriptor)
+    posix::close(m_passfd);
+  for(frame_t& frame : m_outbound)
+    if(frame.passfd != posix::invalid_descriptor)
+      posix::close(frame.passfd);
+}
+
+bool ClientSocket::write(const vfifo& buffer, posix::fd_t passfd) noexcept
+  { return queue(buffer, passfd, nullptr); }
+
+bool ClientSocket::writeTagged(uint32_t tag, const vfifo& buffer) noexcept
+  { return queue(buffer, posix::invalid_descriptor, &tag); }
+
+bool ClientSocket::queue(const vfifo& buffer, posix::fd_t passfd, const uint32_t* tag) noexcept
+{
+  flaw(buffer.size() + (tag == nullptr ? 0 : posix::ssize_t(sizeof(uint32_t))) > MaxFrameSize,
+       terminal::warning,,
+       false,
+       "Message of %li bytes exceeds the maximum frame size", buffer.size())
+
+  flaw(m_socket == posix::invalid_descriptor,
        terminal::warning,,
        false,
-       "sendmsg() failure: %s", posix::strerror(errno));
-  posix::free(aux_buffer);
+       "Unable to write to a disconnected socket")
+
+  posix::ssize_t length = buffer.size() + (tag == nullptr ? 0 : posix::ssize_t(sizeof(uint32_t)));
+  if(passfd == posix::invalid_descriptor &&
+     length >= SharedThreshold &&
+     m_ring_out.ring() &&
+     m_ring_out.unused() >= length) // the peer reads it from shared memory
+  {
+    uint8_t* pos = static_cast<uint8_t*>(m_ring_out.writable().iov_base);
+    if(tag != nullptr)
+    {
+      uint32_t net_tag = htonl(*tag);
+      posix::memcpy(pos, &net_tag, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+    }
+    posix::memcpy(pos, buffer.data(), posix::size_t(buffer.size()));
+    m_ring_out.produce(length);
+    return queueControl(SharedFrame | uint32_t(length), posix::invalid_descriptor);
+  }
+
+  if(passfd != posix::invalid_descriptor) // the caller may close it before it's sent
+  {
+    passfd = ::fcntl(passfd, F_DUPFD_CLOEXEC, 0);
+    flaw(passfd == posix::invalid_descriptor,
+         terminal::warning,,
+         false,
+         "Unable to duplicate file descriptor: %s", posix::strerror(errno))
+  }
+
+  m_outbound.emplace_back(buffer, passfd, tag);
+  queued();
+  return true;
+}
+
+bool ClientSocket::queueControl(uint32_t control, posix::fd_t passfd) noexcept
+{
+  if(passfd != posix::invalid_descriptor) // closed once it's sent
+  {
+    passfd = ::fcntl(passfd, F_DUPFD_CLOEXEC, 0);
+    flaw(passfd == posix::invalid_descriptor,
+         terminal::warning,,
+         false,
+         "Unable to duplicate file descriptor: %s", posix::strerror(errno))
+  }
+
+  m_outbound.emplace_back(control, passfd);
+  queued();
+  return true;
+}
+
+void ClientSocket::queued(void) noexcept
+{
+  m_queued += m_outbound.back().size();
+
+  if(!m_above_high_water && m_high_water && m_queued > m_high_water)
+  {
+    m_above_high_water = true;
+    Object::enqueue_copy(highWater, m_socket, m_queued);
+  }
+
+  if(!m_flush_queued && !m_flags.Writeable) // messages written before the flush are sent together
+    m_flush_queued = Object::singleShot(this, &ClientSocket::flush);
+}
+
+bool ClientSocket::shareMemory(posix::ssize_t capacity) noexcept
+{
+  flaw(m_ring_out.ring(),
+       terminal::warning,,
+       false,
+       "Shared memory has already been passed to the peer")
+
+  flaw(domain() != EDomain::local,
+       terminal::warning,,
+       false,
+       "Shared memory can only be passed to a local peer")
+
+  flaw(capacity < SharedThreshold || capacity > posix::ssize_t(~FrameFlags) / 2,
+       terminal::warning,,
+       false,
+       "Shared ring of %li bytes is outside of the supported range", capacity)
+
+  flaw(m_socket == posix::invalid_descriptor,
+       terminal::warning,,
+       false,
+       "Unable to share memory with a disconnected socket")
+
+  flaw(!m_ring_out.setMode(vfifo::SharedRing, capacity),
+       terminal::warning,,
+       false,
+       "Unable to create shared memory: %s", posix::strerror(errno))
+
+  return queueControl(SharedRingFrame | uint32_t(m_ring_out.capacity()), m_ring_out.descriptor()); // the peer checks the size
+}
+
+bool ClientSocket::flush(void) noexcept
+{
+  m_flush_queued = false;
+  if(m_socket == posix::invalid_descriptor) // disconnected
+    return false;
+
+  if(m_connecting && !established()) // wait for the connection to finish
+    return false;
+
+  while(!m_outbound.empty())
+  {
+    msghdr header = {};
+    posix::size_t skip = m_sent;
+    auto append = [this, &header, &skip](void* base, posix::size_t length) noexcept
+    {
+      if(skip >= length) // already sent
+      {
+        skip -= length;
+        return;
+      }
+      m_iov[header.msg_iovlen].iov_base = static_cast<char*>(base) + skip;
+      m_iov[header.msg_iovlen].iov_len = length - skip;
+      ++header.msg_iovlen;
+      skip = 0;
+    };
+
+    header.msg_iov = m_iov;
+    auto pos = m_outbound.begin();
+    if(pos->passfd != posix::invalid_descriptor) // file descriptors are sent with the start of their own frame
+    {
+      header.msg_control = m_control;
+      header.msg_controllen = sizeof(m_control);
+      cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+      *reinterpret_cast<int*>(CMSG_DATA(cmsg)) = pos->passfd;
+    }
+
+    do // coalesce frames into a single sendmsg()
+    {
+      append(pos->header, pos->header_size);
+      append(pos->payload.data(), posix::size_t(pos->payload.size()));
+      ++pos;
+    } while(pos != m_outbound.end() &&
+            header.msg_iovlen + 2 <= OutboundIOV &&
+            header.msg_control == nullptr &&
+            pos->passfd == posix::invalid_descriptor);
+
+    posix::ssize_t byte_count = posix::sendmsg(m_socket, &header, MSG_NOSIGNAL | MSG_DONTWAIT); // the socket may be blocking
+
+    if(byte_count == posix::error_response && (errno == EAGAIN || errno == EWOULDBLOCK)) // socket is full
+    {
+      if(!m_flags.Writeable) // resume once it's writeable
+        setFlags(m_flags | Writeable);
+      return false;
+    }
+
+    flaw(byte_count == posix::error_response,
+         terminal::warning,,
+         false,
+         "sendmsg() failure: %s", posix::strerror(errno))
+
+    frame_t& first = m_outbound.front();
+    if(first.passfd != posix::invalid_descriptor) // sent with the first byte
+    {
+      posix::close(first.passfd);
+      first.passfd = posix::invalid_descriptor;
+    }
+
+    m_queued -= posix::size_t(byte_count);
+    m_sent += posix::size_t(byte_count);
+    while(!m_outbound.empty() &&
+          m_sent >= m_outbound.front().size()) // remove sent frames
+    {
+      m_sent -= m_outbound.front().size();
+      m_outbound.pop_front();
+    }
+
+    if(m_above_high_water && m_queued <= m_high_water / 2)
+    {
+      m_above_high_water = false;
+      Object::enqueue(lowWater, m_socket);
+    }
+  }
+
+  if(m_flags.Writeable) // stop watching until the socket is full again
+    setFlags(m_flags & ~Writeable);
   return true;
 }
 
@@ -132,22 +464,50 @@ bool ClientSocket::read(posix::fd_t socket, Flags_t flags) noexcept
        false,
        "ClientSocket::read() was improperly called: %s", posix::strerror(int(posix::errc::invalid_argument)))
 
+  if(m_connecting) // flush() finishes the connection first
+    return false;
+
+  if(m_ring_released && !m_ring_in.shared()) // every message read from the shared ring has been released
+  {
+    queueControl(CreditFrame | uint32_t(m_ring_released), posix::invalid_descriptor);
+    m_ring_released = 0;
+  }
+
+  posix::ssize_t required = m_buffer.size() + ReceiveSize;
+  if(m_buffer.size() >= FrameHeaderSize) // a partial frame must fit in the buffer
+  {
+    uint32_t length;
+    posix::memcpy(&length, m_buffer.data(), sizeof(length));
+    required = std::max(required, FrameHeaderSize + payloadSize(ntohl(length)));
+  }
+
+  flaw(m_buffer.discarded() + required > m_buffer.capacity() && // compacts or (if messages still use it) moves away from the current storage
+       !m_buffer.allocate(std::max(m_buffer.capacity(), required)),
+       terminal::severe,,
+       posix::error(posix::errc::not_enough_memory),
+       "Failed to resize buffer to %li bytes", required)
+
   msghdr header = {};
   iovec iov = {};
-  char* aux_buffer = static_cast<char*>(posix::malloc(CMSG_SPACE(sizeof(int))));
-  if(aux_buffer == NULL)
-    return false;
+  union
+  {
+    cmsghdr align;
+    char data[CMSG_SPACE(sizeof(int))];
+  } aux_buffer;
 
   header.msg_iov = &iov;
   header.msg_iovlen = 1;
-  header.msg_control = aux_buffer;
+  header.msg_control = aux_buffer.data;
 
-  iov.iov_base = m_buffer.begin();
-  iov.iov_len = posix::size_t(m_buffer.capacity());
-  header.msg_controllen = CMSG_SPACE(sizeof(int));
+  iov.iov_base = m_buffer.dataEnd();
+  iov.iov_len = posix::size_t(m_buffer.unused());
+  header.msg_controllen = sizeof(aux_buffer.data);
 
   posix::ssize_t byte_count = posix::recvmsg(m_socket, &header, 0);
 
+  if(byte_count == posix::error_response && (errno == EAGAIN || errno == EWOULDBLOCK)) // drained
+    return false;
+
   flaw(byte_count == posix::error_response,
        terminal::warning,,
        false,
@@ -159,19 +519,31 @@ bool ClientSocket::read(posix::fd_t socket, Flags_t flags) noexcept
        false,
        "Socket disconnected.")
 
-  flaw(!m_buffer.allocate(byte_count),
-       terminal::severe,,
-       posix::error(posix::errc::not_enough_memory),
-       "Failed to resize buffer to %li bytes", byte_count)
+  m_buffer.produce(byte_count);
 
-  posix::fd_t passfd = posix::invalid_descriptor;
   if(header.msg_controllen == CMSG_SPACE(sizeof(int)))
   {
     cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
     if(cmsg->cmsg_level == SOL_SOCKET &&
        cmsg->cmsg_type == SCM_RIGHTS &&
        cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
-      passfd = *reinterpret_cast<int*>(CMSG_DATA(cmsg));
+    {
+      if(m_passfd != posix::invalid_descriptor) // previous frame never arrived
+        posix::close(m_passfd);
+      m_passfd = *reinterpret_cast<int*>(CMSG_DATA(cmsg));
+      m_passfd_pos = 0;
+
+      // recvmsg() stops after the data sent with a file descriptor so it belongs to the last frame started
+      for(posix::ssize_t pos = 0; pos < m_buffer.size();)
+      {
+        uint32_t length;
+        m_passfd_pos = pos;
+        if(pos + FrameHeaderSize > m_buffer.size()) // partial header
+          break;
+        posix::memcpy(&length, m_buffer.data() + pos, sizeof(length));
+        pos += FrameHeaderSize + payloadSize(ntohl(length));
+      }
+    }
   }
   else
   {
@@ -180,8 +552,86 @@ bool ClientSocket::read(posix::fd_t socket, Flags_t flags) noexcept
          false,
          "error, message flags: 0x%04x", header.msg_flags)
   }
-  Object::enqueue(newMessage, m_socket, m_buffer, passfd);
-  posix::free(aux_buffer);
+
+  while(m_buffer.size() >= FrameHeaderSize) // enqueue every complete frame
+  {
+    uint32_t header;
+    posix::memcpy(&header, m_buffer.data(), sizeof(header));
+    header = ntohl(header);
+    uint32_t length = header & ~FrameFlags;
+
+    flaw(!(header & (CreditFrame | SharedRingFrame)) && posix::ssize_t(length) > MaxFrameSize,
+         terminal::warning,
+         disconnect(),
+         false,
+         "Frame of %u bytes exceeds the maximum frame size", length)
+
+    posix::ssize_t frame_size = FrameHeaderSize + payloadSize(header);
+    if(m_buffer.size() < frame_size) // partial frame
+      break;
+
+    posix::fd_t passfd = posix::invalid_descriptor;
+    if(!m_passfd_pos)
+      std::swap(passfd, m_passfd);
+
+    if(header & SharedFrame) // payload is in the shared ring
+    {
+      flaw(!m_ring_in.ring() || !m_ring_in.produce(length),
+           terminal::warning,
+           disconnect(),
+           false,
+           "Shared memory frame of %u bytes is outside of the shared ring", length)
+
+      vfifo message = m_ring_in.view(0, length); // no copy
+      Object::enqueue(newMessage, m_socket, message, passfd);
+      m_ring_in.consume(length);
+      m_ring_released += length;
+    }
+    else if(header & FrameFlags)
+    {
+      if(!control(header, passfd))
+        return false;
+    }
+    else
+    {
+      vfifo message = m_buffer.view(FrameHeaderSize, length); // no copy
+      Object::enqueue(newMessage, m_socket, message, passfd);
+    }
+
+    m_buffer.consume(frame_size);
+    m_passfd_pos -= frame_size; // position is relative to the front of the buffer
+  }
+  return true;
+}
+
+bool ClientSocket::control(uint32_t header, posix::fd_t passfd) noexcept
+{
+  if(header & SharedRingFrame) // map the peer's shared ring (only once)
+  {
+    bool mapped = passfd != posix::invalid_descriptor && !m_ring_in.ring();
+    if(mapped)
+      mapped = m_ring_in.attach(passfd, posix::ssize_t(header & ~FrameFlags)); // takes ownership of passfd
+    else if(passfd != posix::invalid_descriptor)
+      posix::close(passfd);
+
+    flaw(!mapped,
+         terminal::warning,
+         disconnect(),
+         false,
+         "Unable to map the peer's shared memory")
+    return true;
+  }
+
+  if(passfd != posix::invalid_descriptor) // no message to deliver it with
+    posix::close(passfd);
+
+  flaw(!(header & CreditFrame) ||
+       !m_ring_out.ring() ||
+       !m_ring_out.consume(posix::ssize_t(header & ~FrameFlags)),
+       terminal::warning,
+       disconnect(),
+       false,
+       "Invalid shared memory credit from peer")
   return true;
 }
 
@@ -221,6 +671,65 @@ bool ServerSocket::bind(const char* socket_path, EDomain domain, int socket_back
   return true;
 }
 
+bool ServerSocket::bind(const char* address, in_port_t port, int socket_backlog) noexcept
+{
+  flaw(m_connected,
+       terminal::warning,,
+       false,
+       "Server socket is already bound!")
+
+  flaw(address == nullptr,
+       terminal::warning,,
+       false,
+       "address is a null value")
+
+  flaw(!m_sockaddr.setAddress(address, port),
+       terminal::warning,,
+       false,
+       "\"%s\" is not a numeric IPv4 or IPv6 address", address)
+
+  posix::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, 1); // rebind while old connections linger in TIME_WAIT
+
+  flaw(!posix::bind(m_socket, m_sockaddr, socklen_t(m_sockaddr.size())),
+       terminal::warning,
+       m_sockaddr = EDomain::unspec,
+       false,
+       "Unable to bind to socket to %s port %u: %s", address, port, posix::strerror(errno))
+  m_connected = true;
+
+  flaw(!posix::listen(m_socket, socket_backlog),
+       terminal::warning,,
+       false,
+       "Unable to listen to server socket: %s", posix::strerror(errno))
+  return true;
+}
+
+bool ServerSocket::setReusePort(bool enable) noexcept
+{
+#if defined(SO_REUSEPORT)
+  flaw(!posix::setsockopt(m_socket, SOL_SOCKET, SO_REUSEPORT, enable ? 1 : 0),
+       terminal::warning,,
+       false,
+       "Unable to set SO_REUSEPORT: %s", posix::strerror(errno))
+  return true;
+#else
+  return !enable;
+#endif
+}
+
+bool ServerSocket::setFastOpen(int queue_length) noexcept
+{
+#if defined(TCP_FASTOPEN)
+  flaw(!posix::setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN, queue_length),
+       terminal::warning,,
+       false,
+       "Unable to set TCP_FASTOPEN: %s", posix::strerror(errno))
+  return true;
+#else
+  return !queue_length;
+#endif
+}
+
 bool ServerSocket::peerData(posix::fd_t socket, posix::sockaddr_t* addr, proccred_t* creds) const noexcept
 {
   auto peer = m_peers.find(socket);
@@ -238,9 +747,11 @@ void ServerSocket::acceptPeerRequest(posix::fd_t socket) noexcept
 {
   if(m_peers.find(socket) != m_peers.end())
   {
-    auto iter = m_connections.emplace(socket, socket).first;
+    auto iter = m_connections.emplace(std::piecewise_construct,
+                                      std::forward_as_tuple(socket),
+                                      std::forward_as_tuple(socket, m_flags & (EdgeTriggered | OneShot))).first;
     Object::connect(iter->second.disconnected, this, &ServerSocket::disconnectPeer);
-    Object::connect(iter->second.newMessage, newPeerMessage);
+    Object::connect(iter->second.newMessage, newPeerMessage, DirectConnection); // slots of newPeerMessage decide how they're called
     Object::enqueue(connectedPeer, socket);
   }
 }
@@ -262,7 +773,7 @@ void ServerSocket::disconnectPeer(posix::fd_t socket) noexcept
   Object::enqueue(disconnectedPeer, socket);
 }
 
-// accepts socket connections and then enqueues newPeerRequest
+// accepts every pending connection and enqueues newPeerRequest for each
 bool ServerSocket::read(posix::fd_t socket, Flags_t flags) noexcept
 {
   (void)flags;
@@ -271,45 +782,225 @@ bool ServerSocket::read(posix::fd_t socket, Flags_t flags) noexcept
        posix::exit(int(posix::errc::invalid_argument)),
        false,
        "ServerSocket::read() was improperly called: %s", posix::strerror(int(posix::errc::invalid_argument)))
-  proccred_t cred;
-  posix::sockaddr_t peeraddr;
-  socklen_t addrlen = 0;
-  posix::fd_t connection = posix::accept(m_socket, peeraddr, &addrlen); // accept a new socket connection
 
-  flaw(connection == posix::error_response,
+  for(;;) // drain the accept queue
+  {
+    proccred_t cred;
+    posix::sockaddr_t peeraddr;
+    socklen_t addrlen = sizeof(sockaddr_un);
+    posix::memset(&peeraddr, 0, sizeof(peeraddr));
+    posix::fd_t connection = posix::accept4(m_socket, peeraddr, &addrlen); // accept a new non-blocking socket connection
+
+    if(connection == posix::error_response && (errno == EAGAIN || errno == EWOULDBLOCK)) // no more pending connections
+      return false;
+
+    flaw(connection == posix::error_response,
+         terminal::warning,,
+         false,
+         "accept4() failure: %s", posix::strerror(errno))
+
+    flaw(addrlen > sizeof(sockaddr_un),
+         terminal::severe,
+         posix::close(connection),
+         false,
+         "accept() implementation bug: %s", "address length exceeds availible storage");
+
+    if(peeraddr != EDomain::local) // network peer
+    {
+      cred = { pid_t(-1), uid_t(-1), gid_t(-1) }; // unavailable
+      if(m_nodelay)
+        posix::setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, 1);
+    }
+    else if(!::recv_cred(connection, cred) || // get creditials of connected peer process
+            !::send_cred(connection))
+    {
+      posix::fprintf(stderr, "%s%s: %s\n", terminal::warning, "Peer credential exchange failure", posix::strerror(errno));
+      posix::close(connection);
+      continue;
+    }
+
+    m_peers.emplace(connection, peer_t(connection, peeraddr, cred));
+    Object::enqueue(newPeerRequest, connection, peeraddr, cred);
+  }
+}
+
+bool ServerSocket::write(posix::fd_t socket, const vfifo& buffer, posix::fd_t passfd) noexcept
+{
+  auto iter = m_connections.find(socket);
+  if(iter != m_connections.end())
+    return iter->second.write(buffer, passfd);
+  return false;
+}
+
+bool ServerSocket::writeTagged(posix::fd_t socket, uint32_t tag, const vfifo& buffer) noexcept
+{
+  auto iter = m_connections.find(socket);
+  if(iter != m_connections.end())
+    return iter->second.writeTagged(tag, buffer);
+  return false;
+}
+
+bool ServerSocket::shareMemory(posix::fd_t socket, posix::ssize_t capacity) noexcept
+{
+  auto iter = m_connections.find(socket);
+  if(iter != m_connections.end())
+    return iter->second.shareMemory(capacity);
+  return false;
+}
+
+// DatagramSocket
+
+bool DatagramSocket::bind(const char* socket_path, EDomain domain) noexcept
+{
+  flaw(m_connected,
        terminal::warning,,
        false,
-       "accept() failure: %s", posix::strerror(errno))
+       "Datagram socket is already bound!")
 
-  flaw(addrlen >= sizeof(sockaddr_un::sun_path),
-       terminal::severe,,
+  flaw(socket_path == nullptr,
+       terminal::warning,,
        false,
-       "accept() implementation bug: %s", "address length exceeds availible storage");
+       "socket_path is a null value")
 
-  flaw(addrlen != peeraddr.size(),
-       terminal::severe,,
+  flaw(posix::strlen(socket_path) >= sizeof(sockaddr_un::sun_path),
+       terminal::warning,,
        false,
-       "accept() implementation bug: %s", "address length does not match string length");
+       "socket_path (%lu characters) exceeds the maximum path length (%lu characters)", posix::strlen(socket_path), sizeof(sockaddr_un::sun_path));
+
+  m_sockaddr = socket_path;
+  m_sockaddr = domain;
 
-  flaw(::recv_cred(m_socket, cred),
+  flaw(!posix::bind(m_socket, m_sockaddr, socklen_t(m_sockaddr.size())),
        terminal::warning,,
        false,
-       "recv_cred() failure: %s", posix::strerror(errno)); // get creditials of connected peer process
+       "Unable to bind to socket to %s: %s", socket_path, posix::strerror(errno))
+  m_connected = true;
+  return true;
+}
+
+bool DatagramSocket::write(const vfifo& buffer) noexcept
+{
+  posix::sockaddr_t peer;
+  peer = EDomain::unspec;
+  return write(buffer, peer);
+}
 
-  flaw(::send_cred(m_socket),
+bool DatagramSocket::write(const vfifo& buffer, const posix::sockaddr_t& peer) noexcept
+{
+  flaw(buffer.size() > MaxDatagramSize,
        terminal::warning,,
        false,
-       "send_cred() failure: %s", posix::strerror(errno)); // get creditials of connected peer process
+       "Message of %li bytes exceeds the maximum datagram size", buffer.size())
+
+  flaw(m_socket == posix::invalid_descriptor,
+       terminal::warning,,
+       false,
+       "Unable to write to a closed socket")
 
-  m_peers.emplace(connection, peer_t(connection, peeraddr, cred));
-  Object::enqueue(newPeerRequest, connection, peeraddr, cred);
+  m_outbound.emplace_back(peer, buffer);
+  if(!m_flush_queued && !m_flags.Writeable) // messages written before the flush are sent together
+    m_flush_queued = Object::singleShot(this, &DatagramSocket::flush);
   return true;
 }
 
-bool ServerSocket::write(posix::fd_t socket, const vfifo& buffer, posix::fd_t passfd) const noexcept
+bool DatagramSocket::flush(void) noexcept
 {
-  auto iter = m_connections.find(socket);
-  if(iter != m_connections.end())
-    return iter->second.write(buffer, passfd);
-  return false;
+  m_flush_queued = false;
+  if(m_socket == posix::invalid_descriptor) // closed
+    return false;
+
+  while(!m_outbound.empty())
+  {
+    unsigned int count = 0;
+    for(auto pos = m_outbound.begin(); pos != m_outbound.end() && count < Batch; ++pos, ++count)
+    {
+      msghdr& header = m_headers[count].msg_hdr;
+      header = {};
+      if(pos->peer != EDomain::unspec)
+      {
+        header.msg_name = static_cast<sockaddr*>(pos->peer);
+        header.msg_namelen = socklen_t(pos->peer.size());
+      }
+      m_iov[count].iov_base = pos->payload.data();
+      m_iov[count].iov_len = posix::size_t(pos->payload.size());
+      header.msg_iov = &m_iov[count];
+      header.msg_iovlen = 1;
+    }
+
+    int sent = posix::sendmmsg(m_socket, m_headers, count, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if(sent == posix::error_response && (errno == EAGAIN || errno == EWOULDBLOCK)) // socket is full
+    {
+      if(!m_flags.Writeable) // resume once it's writeable
+        setFlags(m_flags | Writeable);
+      return false;
+    }
+
+    flaw(sent == posix::error_response,
+         terminal::warning,
+         m_outbound.pop_front(), // discard the message that can't be sent
+         false,
+         "sendmmsg() failure: %s", posix::strerror(errno))
+
+    while(sent--) // remove sent messages
+      m_outbound.pop_front();
+  }
+
+  if(m_flags.Writeable) // stop watching until the socket is full again
+    setFlags(m_flags & ~Writeable);
+  return true;
+}
+
+bool DatagramSocket::read(posix::fd_t socket, Flags_t flags) noexcept
+{
+  (void)flags;
+  flaw(m_socket != socket,
+       terminal::critical,
+       posix::exit(int(posix::errc::invalid_argument)),
+       false,
+       "DatagramSocket::read() was improperly called: %s", posix::strerror(int(posix::errc::invalid_argument)))
+
+  flaw(m_buffer.shared() && // messages from the last batch still use the storage
+       !m_buffer.allocate(m_buffer.capacity()),
+       terminal::severe,,
+       posix::error(posix::errc::not_enough_memory),
+       "Failed to allocate %li bytes", m_buffer.capacity())
+  m_buffer.reset();
+
+  posix::memset(m_peers, 0, sizeof(m_peers));
+  for(unsigned int i = 0; i < Batch; ++i)
+  {
+    msghdr& header = m_headers[i].msg_hdr;
+    header = {};
+    header.msg_name = static_cast<sockaddr*>(m_peers[i]);
+    header.msg_namelen = sizeof(sockaddr_un);
+    m_iov[i].iov_base = m_buffer.begin() + i * MaxDatagramSize;
+    m_iov[i].iov_len = MaxDatagramSize;
+    header.msg_iov = &m_iov[i];
+    header.msg_iovlen = 1;
+  }
+
+  int count = posix::recvmmsg(m_socket, m_headers, Batch, MSG_DONTWAIT);
+
+  if(count == posix::error_response && (errno == EAGAIN || errno == EWOULDBLOCK)) // drained
+    return false;
+
+  flaw(count == posix::error_response,
+       terminal::warning,,
+       false,
+       "recvmmsg() failure: %s", posix::strerror(errno))
+
+  m_buffer.produce(count * MaxDatagramSize);
+  for(int i = 0; i < count; ++i)
+  {
+    if(m_headers[i].msg_hdr.msg_flags & MSG_TRUNC)
+    {
+      posix::fprintf(stderr, "%s%s\n", terminal::warning, "Discarded datagram exceeding the maximum datagram size");
+      continue;
+    }
+    vfifo message = m_buffer.view(i * MaxDatagramSize, m_headers[i].msg_len); // no copy
+    Object::enqueue(newMessage, m_socket, message, m_peers[i]);
+  }
+  m_buffer.consume(m_buffer.size());
+  return count == Batch; // a partial batch means the socket is drained
 }
@@ -2,29 +2,39 @@
 #define SOCKET_H
 
 // STL
+#include <deque>
 #include <unordered_map>
 
+// POSIX
+#include <arpa/inet.h>
+
 // PUT
 #include <put/object.h>
 #include <put/cxxutils/socket_helpers.h>
 #include <put/cxxutils/vfifo.h>
 #include <put/specialized/peercred.h>
 #include <put/specialized/pollevent.h>
+#include <put/specialized/timerevent.h>
 
 class GenericSocket : public PollEvent
 {
 public:
   GenericSocket(EDomain   domain   = EDomain::local,
                 EType     type     = EType::stream,
-                EProtocol protocol = EProtocol::unspec) noexcept;
-  GenericSocket(posix::fd_t socket) noexcept;
+                EProtocol protocol = EProtocol::unspec,
+                Flags_t   mode     = Invalid) noexcept; // mode: EdgeTriggered, OneShot (rearmed once each activation is handled) and/or Exclusive
+  GenericSocket(posix::fd_t socket, Flags_t mode = Invalid) noexcept;
   virtual ~GenericSocket(void) noexcept;
 
+  virtual bool flush(void) noexcept { return true; } // writes queued data (also called when the socket becomes writeable)
+
   signal<posix::fd_t> disconnected; // connection with peer was severed
 protected:
-  virtual bool read(posix::fd_t socket, Flags_t flags) noexcept = 0;
+  virtual bool read(posix::fd_t socket, Flags_t flags) noexcept = 0; // returns false when nothing was read
   void disconnect(void) noexcept;
+  EDomain domain(void) const noexcept; // address family of the socket
   bool m_connected;
+  bool m_connecting = false; // flush() completes the connection
   union
   {
     posix::sockaddr_t m_sockaddr;
@@ -33,31 +43,140 @@ protected:
   posix::fd_t m_socket;
 };
 
+// messages are framed with a 32-bit length prefix (network byte order)
+// large messages to a same-host peer can instead be copied to a shared ring with only the prefix sent (see shareMemory())
 class ClientSocket : public GenericSocket
 {
 public:
   using GenericSocket::GenericSocket;
+  ~ClientSocket(void) noexcept;
+
+  enum : posix::ssize_t
+  {
+    FrameHeaderSize = sizeof(uint32_t),
+    MaxFrameSize = 0x01000000, // 16 MiB
+    SharedRingSize = 0x00400000, // 4 MiB
+  };
+
+  enum : milliseconds_t
+  {
+    ConnectTimeout = 5000,
+  };
 
   bool isConnected(void) const noexcept { return GenericSocket::m_connected; }
 
   bool connect(const char *socket_path) noexcept;
+  bool connect(const char* address, in_port_t port) noexcept; // numeric IPv4/IPv6 address (socket must be EDomain::inet/inet6), same as connectAsync() with ConnectTimeout
+  bool connectAsync(const posix::sockaddr_t& peer, milliseconds_t timeout = ConnectTimeout) noexcept; // returns immediately (0 timeout waits indefinitely)
+  bool isConnecting(void) const noexcept { return m_connecting; }
+
+  bool setNoDelay(bool enable = true) noexcept; // TCP: send small messages immediately (disables Nagle's algorithm)
+  bool setFastOpen(bool enable = true) noexcept; // TCP: call before connect() so the first message is sent with the SYN
 
-  bool write(const vfifo& buffer, posix::fd_t passfd = posix::invalid_descriptor) const noexcept;
+  bool write(const vfifo& buffer, posix::fd_t passfd = posix::invalid_descriptor) noexcept; // queues a message (shares buffer's storage)
+  bool writeTagged(uint32_t tag, const vfifo& buffer) noexcept; // queues a message prefixed with tag (network byte order)
+  bool flush(void) noexcept; // sends queued messages (returns false when the socket is full)
+  bool shareMemory(posix::ssize_t capacity = SharedRingSize) noexcept; // passes a shared ring to the peer for large messages
+
+  posix::size_t queued(void) const noexcept { return m_queued; } // bytes waiting to be sent
+  void setHighWaterMark(posix::size_t bytes) noexcept { m_high_water = bytes; } // 0 disables highWater
 
   signal<posix::fd_t, posix::sockaddr_t, proccred_t> connected; // peer is connected
-  signal<posix::fd_t, vfifo, posix::fd_t> newMessage; // message received
+  signal<posix::fd_t, posix::error_t> connectFailed; // connectAsync() failed or timed out (followed by disconnected)
+  signal<posix::fd_t, vfifo, posix::fd_t> newMessage; // message received (shares the receive buffer)
+  signal<posix::fd_t, posix::size_t> highWater; // queued bytes exceeded the high water mark (stop writing)
+  signal<posix::fd_t> lowWater; // queued bytes fell to half of the high water mark (resume writing)
 
 private:
-  bool read(posix::fd_t socket, Flags_t flags) noexcept; // buffers incomming data and then enqueues newMessage
-  vfifo m_buffer;
+  enum : posix::ssize_t
+  {
+    ReceiveBufferSize = 0x00040000, // 256 KiB
+    ReceiveSize = 0x00010000, // minimum space for each read
+    HighWaterMark = 0x00400000, // 4 MiB
+    OutboundIOV = 64, // two per frame
+    SharedThreshold = 0x00001000, // smallest message copied to the shared ring
+  };
+
+  enum : uint32_t // high bits of the length prefix (no payload follows these on the socket)
+  {
+    SharedFrame     = 0x80000000, // payload is in the sender's shared ring
+    SharedRingFrame = 0x40000000, // attached file descriptor is the sender's shared ring (of the size in the low bits)
+    CreditFrame     = 0x20000000, // bytes of our shared ring that the peer has released
+    FrameFlags      = SharedFrame | SharedRingFrame | CreditFrame,
+  };
+
+  struct frame_t
+  {
+    uint32_t header[2]; // length and optional tag (network byte order)
+    posix::size_t header_size;
+    vfifo payload;
+    posix::fd_t passfd; // duplicate that is closed once sent
+    frame_t(const vfifo& p, posix::fd_t fd, const uint32_t* tag) noexcept
+      : header_size(tag == nullptr ? sizeof(uint32_t) : sizeof(header)), payload(p), passfd(fd)
+    {
+      header[0] = htonl(uint32_t(header_size - sizeof(uint32_t) + posix::size_t(p.size())));
+      header[1] = tag == nullptr ? 0 : htonl(*tag);
+    }
+    frame_t(uint32_t control, posix::fd_t fd) noexcept
+      : header_size(sizeof(uint32_t)), payload(0), passfd(fd)
+    {
+      header[0] = htonl(control);
+      header[1] = 0;
+    }
+    posix::size_t size(void) const noexcept { return header_size + posix::size_t(payload.size()); }
+  };
+
+  static posix::ssize_t payloadSize(uint32_t header) noexcept // bytes following the length prefix on the socket
+    { return header & FrameFlags ? 0 : posix::ssize_t(header); }
+
+  bool queue(const vfifo& buffer, posix::fd_t passfd, const uint32_t* tag) noexcept;
+  bool queueControl(uint32_t control, posix::fd_t passfd) noexcept;
+  void queued(void) noexcept; // accounts for the last frame queued
+  bool control(uint32_t header, posix::fd_t passfd) noexcept; // handles frames without a payload on the socket
+
+  bool established(void) noexcept; // finishes connectAsync() once the socket is writeable
+  void connectFailure(posix::error_t error) noexcept;
+  void connectTimeout(void) noexcept;
+
+  bool read(posix::fd_t socket, Flags_t flags) noexcept; // buffers incomming data and then enqueues newMessage for each complete frame
+  vfifo m_buffer { ReceiveBufferSize };
+  posix::fd_t m_passfd = posix::invalid_descriptor; // file descriptor waiting for it's frame
+  posix::ssize_t m_passfd_pos = 0; // position of the frame m_passfd was sent with
+
+  std::deque<frame_t> m_outbound;
+  posix::size_t m_queued = 0;
+  posix::size_t m_sent = 0; // bytes of the first frame that have been sent
+  posix::size_t m_high_water = HighWaterMark;
+  bool m_above_high_water = false;
+  bool m_flush_queued = false;
+  iovec m_iov[OutboundIOV];
+  alignas(cmsghdr) char m_control[CMSG_SPACE(sizeof(int))]; // SCM_RIGHTS control message
+
+  vfifo m_ring_out { 0 }; // shared ring written by this socket (queued bytes wait for the peer to credit them)
+  vfifo m_ring_in { 0 }; // shared ring written by the peer
+  posix::size_t m_ring_released = 0; // bytes read from m_ring_in that the peer hasn't been credited for
+
+  TimerEvent* m_deadline = nullptr; // connectAsync() timeout
 };
 
 class ServerSocket : public GenericSocket
 {
 public:
-  using GenericSocket::GenericSocket;
+  ServerSocket(EDomain   domain   = EDomain::local,
+               EType     type     = EType::stream,
+               EProtocol protocol = EProtocol::unspec,
+               Flags_t   mode     = Invalid) noexcept // mode is also used for peer connections
+    : GenericSocket(domain, type, protocol, mode) { posix::donotblock(m_socket); } // accept() until EAGAIN
+  ServerSocket(posix::fd_t socket, Flags_t mode = Invalid) noexcept
+    : GenericSocket(socket, mode) { posix::donotblock(m_socket); } // accept() until EAGAIN
 
   bool bind(const char* socket_path, EDomain domain = EDomain::local, int socket_backlog = SOMAXCONN) noexcept;
+  bool bind(const char* address, in_port_t port, int socket_backlog = SOMAXCONN) noexcept; // numeric IPv4/IPv6 address (socket must be EDomain::inet/inet6)
+
+  // TCP options (call before bind())
+  bool setReusePort(bool enable = true) noexcept; // listeners bound to the same port share incoming connections (one per event loop)
+  bool setFastOpen(int queue_length = 256) noexcept; // accept data sent with the SYN (0 disables)
+  void setNoDelay(bool enable = true) noexcept { m_nodelay = enable; } // disables Nagle's algorithm for accepted connections
 
   bool peerData(posix::fd_t socket, posix::sockaddr_t* addr = nullptr, proccred_t* creds = nullptr) const noexcept;
   void acceptPeerRequest(posix::fd_t socket) noexcept;
@@ -68,7 +187,9 @@ public:
   signal<posix::fd_t> disconnectedPeer; // connection with peer was severed
   signal<posix::fd_t, vfifo, posix::fd_t> newPeerMessage; // message received from peer
 
-  bool write(posix::fd_t socket, const vfifo& buffer, posix::fd_t passfd = posix::invalid_descriptor) const noexcept;
+  bool write(posix::fd_t socket, const vfifo& buffer, posix::fd_t passfd = posix::invalid_descriptor) noexcept;
+  bool writeTagged(posix::fd_t socket, uint32_t tag, const vfifo& buffer) noexcept;
+  bool shareMemory(posix::fd_t socket, posix::ssize_t capacity = ClientSocket::SharedRingSize) noexcept;
 private:
   struct peer_t
   {
@@ -80,9 +201,57 @@ private:
   };
 
   void disconnectPeer(posix::fd_t socket) noexcept;
-  bool read(posix::fd_t socket, Flags_t flags) noexcept; // accepts socket connections and then enqueues newPeerRequest
+  bool read(posix::fd_t socket, Flags_t flags) noexcept; // accepts every pending connection and enqueues newPeerRequest for each
   std::unordered_map<posix::fd_t, peer_t> m_peers;
   std::unordered_map<posix::fd_t, ClientSocket> m_connections;
+  bool m_nodelay = false;
+};
+
+// connectionless socket that receives and sends batches of messages with each system call
+class DatagramSocket : public GenericSocket
+{
+public:
+  DatagramSocket(EDomain   domain   = EDomain::local,
+                 EProtocol protocol = EProtocol::unspec,
+                 Flags_t   mode     = Invalid) noexcept
+    : GenericSocket(domain, EType::datagram, protocol, mode) { }
+  DatagramSocket(posix::fd_t socket, Flags_t mode = Invalid) noexcept
+    : GenericSocket(socket, mode) { }
+
+  enum : posix::ssize_t
+  {
+    MaxDatagramSize = 0x00004000, // 16 KiB (larger messages are discarded)
+  };
+
+  bool bind(const char* socket_path, EDomain domain = EDomain::local) noexcept;
+
+  bool write(const vfifo& buffer) noexcept; // queues a message to the connected peer (shares buffer's storage)
+  bool write(const vfifo& buffer, const posix::sockaddr_t& peer) noexcept; // queues a message to peer (shares buffer's storage)
+  bool flush(void) noexcept; // sends queued messages (returns false when the socket is full)
+
+  signal<posix::fd_t, vfifo, posix::sockaddr_t> newMessage; // message received (shares the receive buffer)
+
+private:
+  enum : unsigned int
+  {
+    Batch = 32, // messages for each recvmmsg()/sendmmsg()
+  };
+
+  struct datagram_t
+  {
+    posix::sockaddr_t peer; // EDomain::unspec for the connected peer
+    vfifo payload;
+    datagram_t(const posix::sockaddr_t& a, const vfifo& p) noexcept
+      : peer(a), payload(p) { }
+  };
+
+  bool read(posix::fd_t socket, Flags_t flags) noexcept; // receives a batch of messages and enqueues newMessage for each
+  vfifo m_buffer { Batch * MaxDatagramSize };
+  std::deque<datagram_t> m_outbound;
+  bool m_flush_queued = false;
+  mmsghdr m_headers[Batch];
+  iovec m_iov[Batch];
+  posix::sockaddr_t m_peers[Batch];
 };
 
 #endif // SOCKET_H
@@ -8,8 +8,16 @@
 #define MAX_EVENTS 1024
 #endif
 
-posix::lockable<std::unordered_multimap<posix::fd_t, EventBackend::callback_info_t>> EventBackend::queue;
-std::list<std::pair<posix::fd_t, native_flags_t>> EventBackend::results;
+static thread_local EventBackend::instance_t* s_current = nullptr; // backend used by this thread
+
+EventBackend::instance_t& EventBackend::current(void) noexcept
+{
+  static instance_t default_instance; // constructed on first use (static object constructors may use it)
+  return s_current == nullptr ? default_instance : *s_current;
+}
+
+void EventBackend::setCurrent(instance_t* instance) noexcept
+  { s_current = instance; }
 
 #if defined(FORCE_POSIX_POLL)
 # pragma message("Forcing use of POSIX polling.")
@@ -20,14 +28,195 @@ std::list<std::pair<posix::fd_t, native_flags_t>> EventBackend::results;
 // Linux
 # include <sys/epoll.h>
 
-struct EventBackend::platform_dependant // poll notification (epoll)
+# if !defined(EPOLLEXCLUSIVE) // Linux 4.5+
+#  define EPOLLEXCLUSIVE 0
+# endif
+
+# if !defined(FORCE_EPOLL) && KERNEL_VERSION_CODE >= KERNEL_VERSION(5,13,0) && defined(__has_include) /* Linux 5.13+ */
+#  if __has_include(<linux/io_uring.h>)
+#   define IO_URING_BACKEND
+#  endif
+# endif
+
+# if defined(IO_URING_BACKEND)
+// Linux
+#  include <linux/io_uring.h>
+
+// POSIX
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+
+// STL
+#  include <algorithm>
+
+static constexpr uint32_t epoll_modes = uint32_t(EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE);
+static constexpr uint64_t ignored_data = 1; // user data of requests without a watch (never a valid pointer)
+
+struct uring_t // io_uring without liburing
 {
+  posix::fd_t fd;
+  uint32_t entries;
+  uint32_t* sq_head;
+  uint32_t* sq_tail;
+  uint32_t* sq_mask;
+  uint32_t* sq_array;
+  uint32_t* cq_head;
+  uint32_t* cq_tail;
+  uint32_t* cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void* ring;
+  posix::size_t ring_size;
+  posix::size_t sqes_size;
+  struct __kernel_timespec timeout;
+  bool waiting; // the event loop is waiting in enter() (requests must be submitted to reach it)
+
+  uring_t(void) noexcept
+    : fd(posix::invalid_descriptor), sqes(nullptr), ring(MAP_FAILED), waiting(false) { }
+
+  ~uring_t(void) noexcept
+  {
+    if(ring != MAP_FAILED)
+      ::munmap(ring, ring_size);
+    if(sqes != nullptr)
+      ::munmap(sqes, sqes_size);
+    if(fd != posix::invalid_descriptor)
+      posix::close(fd);
+  }
+
+  bool setup(void) noexcept
+  {
+    struct io_uring_params params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = MAX_EVENTS * 2;
+    fd = posix::fd_t(::syscall(__NR_io_uring_setup, MAX_EVENTS, &params));
+    if(fd == posix::invalid_descriptor)
+      return false;
+
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || // Linux 5.4+
+       !(params.features & IORING_FEAT_NODROP) || // Linux 5.5+
+       !(params.features & IORING_FEAT_RSRC_TAGS)) // Linux 5.13+ (multishot poll)
+      return false;
+
+    ring_size = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                         params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    ring = ::mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring == MAP_FAILED)
+      return false;
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes_map = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes_map == MAP_FAILED)
+      return false;
+
+    uint8_t* base = static_cast<uint8_t*>(ring);
+    entries  = params.sq_entries;
+    sq_head  = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+    sq_tail  = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+    sq_mask  = reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+    cq_head  = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+    cq_tail  = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+    cq_mask  = reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+    cqes     = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+    sqes     = static_cast<struct io_uring_sqe*>(sqes_map);
+    posix::fcntl(fd, F_SETFD, FD_CLOEXEC); // close on exec*()
+    return true;
+  }
+
+  uint32_t unsubmitted(void) const noexcept
+    { return *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE); }
+
+  int enter(uint32_t to_submit, uint32_t min_complete) noexcept
+    { return int(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0)); }
+
+  // requests are only queued here and submitted together when polling
+  // the submission queue has a single producer so the caller must hold the queue lock
+  struct io_uring_sqe* request(uint8_t opcode, posix::fd_t target, uint64_t user_data) noexcept
+  {
+    if(unsubmitted() == entries) // submission queue is full
+      enter(entries, 0);
+
+    uint32_t tail = *sq_tail;
+    uint32_t index = tail & *sq_mask;
+    struct io_uring_sqe* sqe = sqes + index;
+    posix::memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = target;
+    sqe->user_data = user_data;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+  }
+
+  void poll(posix::fd_t target, native_flags_t flags, EventBackend::watch_t* watch) noexcept
+  {
+    uint32_t events = uint32_t(flags) & ~epoll_modes; // epoll event bits match poll() bits
+#  if __BYTE_ORDER == __BIG_ENDIAN
+    events = (events << 16) | (events >> 16); // poll32_events is word-reversed
+#  endif
+    struct io_uring_sqe* sqe = request(IORING_OP_POLL_ADD, target, reinterpret_cast<uint64_t>(watch));
+    sqe->poll32_events = events;
+    if((flags & EPOLLET) && !(flags & EPOLLONESHOT)) // multishot poll only reports new readiness
+      sqe->len = IORING_POLL_ADD_MULTI;
+    ++watch->pending;
+  }
+
+  void cancel(EventBackend::watch_t* watch) noexcept
+  {
+    struct io_uring_sqe* sqe = request(IORING_OP_POLL_REMOVE, -1, ignored_data);
+    sqe->addr = reinterpret_cast<uint64_t>(watch);
+  }
+
+  // queues the timeout and returns the number of requests to submit with enter() (caller must hold the queue lock)
+  uint32_t prepare(milliseconds_t milliseconds) noexcept
+  {
+    if(milliseconds > 0) // timeout completes when any other request does
+    {
+      timeout.tv_sec = milliseconds / 1000;
+      timeout.tv_nsec = (milliseconds % 1000) * 1000000;
+      struct io_uring_sqe* sqe = request(IORING_OP_TIMEOUT, -1, ignored_data);
+      sqe->addr = reinterpret_cast<uint64_t>(&timeout);
+      sqe->len = 1;
+      sqe->off = 1;
+    }
+    return unsubmitted();
+  }
+
+  void wake(void) noexcept // submits requests queued by another thread while the event loop waits (caller must hold the queue lock)
+  {
+    if(waiting && unsubmitted())
+      enter(unsubmitted(), 0);
+  }
+};
+# endif
+
+struct EventBackend::platform_dependant // poll notification (io_uring or epoll)
+{
+  struct key_t
+  {
+    watch_t* watch; // nullptr once freed
+    uint32_t generation; // incremented each time the key is reused
+  };
+
   posix::fd_t fd;
   struct epoll_event output[MAX_EVENTS];
+  std::vector<key_t> keys; // watches by key index
+  std::vector<uint32_t> unused_keys;
+# if defined(IO_URING_BACKEND)
+  uring_t* uring; // nullptr when io_uring is unavailable
+# endif
 
   platform_dependant(void) noexcept
     : fd(posix::invalid_descriptor)
   {
+# if defined(IO_URING_BACKEND)
+    uring = new uring_t;
+    if(uring->setup())
+      return;
+    delete uring; // fall back on epoll
+    uring = nullptr;
+# endif
     fd = ::epoll_create(1);
     flaw(fd == posix::invalid_descriptor,
          terminal::critical,
@@ -38,39 +227,170 @@ struct EventBackend::platform_dependant // poll notification (epoll)
 
   ~platform_dependant(void) noexcept
   {
-    posix::close(fd);
+# if defined(IO_URING_BACKEND)
+    delete uring;
+# endif
+    if(fd != posix::invalid_descriptor)
+      posix::close(fd);
     fd = posix::invalid_descriptor;
   }
 
-  bool add(posix::fd_t wd, native_flags_t flags) noexcept
+  bool add(posix::fd_t wd, native_flags_t flags, watch_t* watch) noexcept
   {
+# if defined(IO_URING_BACKEND)
+    if(uring != nullptr)
+    {
+      if(watch->registered) // replace existing poll request
+        uring->cancel(watch);
+      uring->poll(wd, flags, watch);
+      uring->wake();
+      return watch->registered = true;
+    }
+# endif
     struct epoll_event native_event;
-    native_event.data.fd = wd;
+    native_event.data.u64 = key(watch); // results lead straight to the callbacks
     native_event.events = uint32_t(flags); // be sure to convert to native events
-    return ::epoll_ctl(fd, EPOLL_CTL_ADD, wd, &native_event) == posix::success_response || // add new event OR
-        (errno == EEXIST && ::epoll_ctl(fd, EPOLL_CTL_MOD, wd, &native_event) == posix::success_response); // modify existing event
+
+    if(watch->registered && (flags & EPOLLEXCLUSIVE)) // exclusive FDs can't be modified, only readded
+      remove(wd, watch);
+
+    if(watch->registered) // modify existing event (recreate it if the FD was closed without being removed)
+      watch->registered = ::epoll_ctl(fd, EPOLL_CTL_MOD, wd, &native_event) == posix::success_response ||
+                          (errno == ENOENT && ::epoll_ctl(fd, EPOLL_CTL_ADD, wd, &native_event) == posix::success_response);
+    else // add new event (modify it if it was added by another watch)
+      watch->registered = ::epoll_ctl(fd, EPOLL_CTL_ADD, wd, &native_event) == posix::success_response ||
+                          (errno == EEXIST && ::epoll_ctl(fd, EPOLL_CTL_MOD, wd, &native_event) == posix::success_response);
+    return watch->registered;
   }
 
-  bool remove(posix::fd_t wd) noexcept
+  bool remove(posix::fd_t wd, watch_t* watch) noexcept
   {
+# if defined(IO_URING_BACKEND)
+    if(uring != nullptr)
+    {
+      if(watch == nullptr || !watch->registered)
+        return false;
+      uring->cancel(watch);
+      uring->wake();
+      watch->registered = false;
+      return true;
+    }
+# endif
     struct epoll_event event;
+    if(watch != nullptr)
+      watch->registered = false;
     return ::epoll_ctl(fd, EPOLL_CTL_DEL, wd, &event) == posix::success_response; // try to delete entry
   }
-} EventBackend::s_platform;
+
+  // an FD closed before being removed stays in epoll while any duplicate of it is open, so
+  // epoll reports a key instead of the watch pointer and keys of freed watches never match again
+  uint64_t key(watch_t* watch) noexcept
+  {
+    if(!watch->key)
+    {
+      uint32_t index;
+      if(unused_keys.empty())
+      {
+        index = uint32_t(keys.size());
+        keys.push_back(key_t { nullptr, 0 });
+      }
+      else
+      {
+        index = unused_keys.back();
+        unused_keys.pop_back();
+      }
+      keys[index].watch = watch;
+      ++keys[index].generation;
+      watch->key = (uint64_t(keys[index].generation) << 32) | index;
+    }
+    return watch->key;
+  }
+
+  watch_t* lookup(uint64_t native_key) const noexcept // nullptr if the watch was freed
+  {
+    uint32_t index = uint32_t(native_key);
+    return index < keys.size() && keys[index].generation == uint32_t(native_key >> 32)
+        ? keys[index].watch
+        : nullptr;
+  }
+
+  void release(watch_t* watch) noexcept // watch is about to be freed
+  {
+    if(watch->key)
+    {
+      keys[uint32_t(watch->key)].watch = nullptr;
+      unused_keys.push_back(uint32_t(watch->key));
+      watch->key = 0;
+    }
+  }
+};
 
 const native_flags_t EventBackend::SimplePollReadFlags = EPOLLIN;
 
-bool EventBackend::poll(milliseconds_t timeout) noexcept
+bool EventBackend::instance_t::poll(milliseconds_t timeout) noexcept
 {
-  int count = ::epoll_wait(s_platform.fd, s_platform.output, MAX_EVENTS, timeout); // wait for new results
+# if defined(IO_URING_BACKEND)
+  uring_t* uring = platform->uring;
+  if(uring != nullptr)
+  {
+    queue.lock(); // get exclusive access (make thread-safe)
+    for(result_t& result : results) // poll requests only complete once so rearm level triggered ones
+    {
+      native_flags_t flags = 0;
+      for(callback_info_t& entry : result.watch->callbacks)
+        flags |= entry.flags;
+      if(flags && !result.watch->registered && !(flags & EPOLLONESHOT))
+        platform->add(result.watch->fd, flags, result.watch);
+    }
+    results.clear(); // clear old results
+    queue.unlock(); // access is no longer needed
+    collect();
+
+    queue.lock(); // get exclusive access (make thread-safe)
+    uint32_t to_submit = uring->prepare(timeout);
+    uring->waiting = true; // requests queued from now on are submitted by the thread that queues them
+    queue.unlock(); // access is no longer needed
+
+    uring->enter(to_submit, timeout ? 1 : 0); // submit queued requests and wait for new results
+
+    queue.lock(); // get exclusive access (make thread-safe)
+    uring->waiting = false;
+    uint32_t head = *uring->cq_head;
+    uint32_t tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail && results.size() < MAX_EVENTS; ++head) // iterate through results
+    {
+      const struct io_uring_cqe& cqe = uring->cqes[head & *uring->cq_mask];
+      if(cqe.user_data <= ignored_data) // timeout or cancellation
+        continue;
+
+      watch_t* watch = reinterpret_cast<watch_t*>(cqe.user_data);
+      if(!(cqe.flags & IORING_CQE_F_MORE) && !--watch->pending) // request is finished
+        watch->registered = false;
+      if(cqe.res > 0)
+        results.push_back({ watch, native_flags_t(cqe.res) }); // save result (in native format)
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    queue.unlock(); // access is no longer needed
+    return true;
+  }
+# endif
+
   results.clear(); // clear old results
+  collect();
+  int count = ::epoll_wait(platform->fd, platform->output, MAX_EVENTS, timeout); // wait for new results
 
   if(count == posix::error_response) // if error/timeout occurred
     return false; //fail
 
-  const epoll_event* end = s_platform.output + count;
-  for(epoll_event* pos = s_platform.output; pos != end; ++pos) // iterate through results
-    results.emplace_back(std::make_pair(posix::fd_t(pos->data.fd), native_flags_t(pos->events))); // save result (in native format)
+  queue.lock(); // get exclusive access (make thread-safe)
+  const epoll_event* end = platform->output + count;
+  for(epoll_event* pos = platform->output; pos != end; ++pos) // iterate through results
+  {
+    watch_t* watch = platform->lookup(pos->data.u64);
+    if(watch != nullptr) // ignore FDs that were closed before being removed
+      results.push_back({ watch, native_flags_t(pos->events) }); // save result (in native format)
+  }
+  queue.unlock(); // access is no longer needed
   return true;
 }
 
@@ -126,37 +446,40 @@ struct EventBackend::platform_dependant // poll notification (kqueue)
     posix::close(kq);
   }
 
-  bool add(posix::fd_t fd, native_flags_t flags) noexcept
+  bool add(posix::fd_t fd, native_flags_t flags, watch_t* watch) noexcept
   {
     struct kevent ev;
-    EV_SET(&ev, fd, extract_filter(flags), EV_ADD | extract_actions(flags), extract_flags(flags), extract_data(flags), NULL);
+    EV_SET(&ev, fd, extract_filter(flags), EV_ADD | extract_actions(flags), extract_flags(flags), extract_data(flags), watch);
     return ::kevent(kq, &ev, 1, NULL, 0, NULL) == posix::success_response;
   }
 
-  bool remove(posix::fd_t fd) noexcept
+  bool remove(posix::fd_t fd, watch_t*) noexcept
   {
     struct kevent ev;
     EV_SET(&ev, fd, 0, EV_DELETE, 0, 0, NULL);
     return ::kevent(kq, &ev, 1, NULL, 0, NULL) == posix::success_response;
   }
 
-} EventBackend::s_platform;
+  void release(watch_t*) noexcept { } // closing an FD removes its events
+};
 
 const native_flags_t EventBackend::SimplePollReadFlags = platform_dependant::composite_flag(0, EVFILT_READ, 0);
 
-bool EventBackend::poll(milliseconds_t timeout) noexcept
+bool EventBackend::instance_t::poll(milliseconds_t timeout) noexcept
 {
   timespec tout;
   tout.tv_sec = timeout / 1000;
   tout.tv_nsec = (timeout % 1000) * 1000;
 
-  int count = kevent(s_platform.kq, NULL, 0, s_platform.koutput.data(), s_platform.koutput.size(), &tout);
+  results.clear(); // clear old results
+  collect();
+  int count = kevent(platform->kq, NULL, 0, platform->koutput.data(), platform->koutput.size(), &tout);
   if(count <= 0)
     return false;
 
-  struct kevent* end = s_platform.koutput.data() + count;
-  for(struct kevent* pos = s_platform.koutput.data(); pos != end; ++pos) // iterate through results
-    results.emplace_back(std::make_pair(posix::fd_t(pos->ident), platform_dependant::composite_flag(pos->flags, pos->filter, pos->fflags)));
+  struct kevent* end = platform->koutput.data() + count;
+  for(struct kevent* pos = platform->koutput.data(); pos != end; ++pos) // iterate through results
+    results.push_back({ static_cast<watch_t*>(pos->udata), platform_dependant::composite_flag(pos->flags, pos->filter, pos->fflags) });
   return true;
 }
 
@@ -302,6 +625,7 @@ struct EventBackend::platform_dependant // poll notification (epoll)
 {
   nfds_t max;
   struct pollfd io[MAX_EVENTS];
+  watch_t* watches[MAX_EVENTS]; // watch for each pollfd
 
   platform_dependant(void) noexcept
   {
@@ -310,7 +634,7 @@ struct EventBackend::platform_dependant // poll notification (epoll)
       io[i].fd = posix::invalid_descriptor;
   }
 
-  bool add(posix::fd_t wd, native_flags_t flags) noexcept
+  bool add(posix::fd_t wd, native_flags_t flags, watch_t* watch) noexcept
   {
     struct pollfd* pos = io;
     struct pollfd* end = pos + MAX_EVENTS;
@@ -330,11 +654,12 @@ struct EventBackend::platform_dependant // poll notification (epoll)
     {
       pos->fd = wd;
       pos->events = short(flags);
+      watches[pos - io] = watch;
     }
     return pos < end;
   }
 
-  bool remove(posix::fd_t wd) noexcept
+  bool remove(posix::fd_t wd, watch_t*) noexcept
   {
     struct pollfd* pos = io;
     struct pollfd* end = pos + MAX_EVENTS;
@@ -349,64 +674,166 @@ struct EventBackend::platform_dependant // poll notification (epoll)
     }
     return pos < end;
   }
-} EventBackend::s_platform;
+
+  void release(watch_t*) noexcept { } // removed FDs are never reported
+};
 
 const native_flags_t EventBackend::SimplePollReadFlags = POLLIN;
 
-bool EventBackend::poll(milliseconds_t timeout) noexcept
+bool EventBackend::instance_t::poll(milliseconds_t timeout) noexcept
 {
-  int rval = posix::ignore_interruption<int, pollfd*, nfds_t, int>(::poll, s_platform.io, s_platform.max, timeout);
+  results.clear(); // clear old results
+  collect();
+  int rval = posix::ignore_interruption<int, pollfd*, nfds_t, int>(::poll, platform->io, platform->max, timeout);
   if(rval == posix::error_response)
     return false;
 
-  struct pollfd* pos = s_platform.io;
-  struct pollfd* end = pos + s_platform.max;
+  struct pollfd* pos = platform->io;
+  struct pollfd* end = pos + platform->max;
   for(; pos != end; ++pos) // iterate through results
-    results.emplace_back(std::make_pair(pos->fd, native_flags_t(pos->revents))); // save result (in native format)
+    if(pos->fd != posix::invalid_descriptor && pos->revents)
+      results.push_back({ platform->watches[pos - platform->io], native_flags_t(pos->revents) }); // save result (in native format)
   return true;
 }
 #endif
 
-bool EventBackend::add(posix::fd_t fd, native_flags_t flags, callback_t function) noexcept
+EventBackend::instance_t::instance_t(void) noexcept
+  : platform(new platform_dependant)
+{
+  results.reserve(MAX_EVENTS); // no allocations when polling
+}
+
+EventBackend::instance_t::~instance_t(void) noexcept
 {
+  for(watch_t* watch : m_dirty) // free watches replaced while the backend could report them
+  {
+    auto iter = queue.find(watch->fd);
+    if(iter == queue.end() || iter->second != watch)
+      delete watch;
+  }
+  for(auto& pair : queue)
+    delete pair.second;
+  delete platform;
+  platform = nullptr;
+}
+
+bool EventBackend::instance_t::add(posix::fd_t fd, native_flags_t flags, callback_t function) noexcept
+{
+#if defined(IO_URING_BACKEND)
+  if(platform->uring != nullptr && (flags & EPOLLEXCLUSIVE)) // each ring polling the FD is woken
+  {
+    errno = EOPNOTSUPP;
+    return false;
+  }
+#endif
+
   native_flags_t total_flags = flags;
-  bool found = false;
-  auto iter_pair = queue.equal_range(fd); // find modified entry!
-  for(auto& pos = iter_pair.first; pos != iter_pair.second; ++pos)
+  queue.lock(); // get exclusive access (make thread-safe)
+  watch_t*& watch = queue[fd];
+  if(watch != nullptr && watch->pending) // if only removed callbacks remain but old requests may still report them
   {
-    total_flags |= pos->second.flags;
-    found |= &(pos->second.function) == &function; // save if function was ever found
-    if(&(pos->second.function) == &function) // if the FD is in the queue and it's callback function matches
-      pos->second.flags |= flags; // simply modify the flags to include the current
+    bool active = false;
+    for(callback_info_t& entry : watch->callbacks)
+      active |= entry.flags != 0;
+    if(!active) // leave it for collect() to free
+      watch = nullptr;
   }
 
-  if(!found) // function wasn't found
-    queue.emplace(fd, callback_info_t{flags, function}); // make a new entry for this FD
+  if(watch == nullptr) // first callback for this FD
+    watch = new watch_t { fd, std::list<callback_info_t>(), false, false, 0, 0 };
 
-  return s_platform.add(fd, total_flags);
+  for(callback_info_t& entry : watch->callbacks)
+    total_flags |= entry.flags;
+  watch->callbacks.push_back(callback_info_t { flags, function }); // make a new entry for this FD
+  bool rval = platform->add(fd, total_flags, watch);
+  queue.unlock(); // access is no longer needed
+  return rval;
 }
 
-bool EventBackend::remove(posix::fd_t fd, native_flags_t flags) noexcept
+bool EventBackend::instance_t::remove(posix::fd_t fd, native_flags_t flags) noexcept
 {
   native_flags_t remaining_flags = 0;
-  auto iter_pair = queue.equal_range(fd); // find modified entry!
-  auto& pos = iter_pair.first;
-  while(pos != iter_pair.second)
+  queue.lock(); // get exclusive access (make thread-safe)
+  auto iter = queue.find(fd);
+  if(iter != queue.end())
   {
-    if((pos->second.flags & flags) == pos->second.flags) // if all flags match
-      pos = queue.erase(pos);
-    else
+    watch_t* watch = iter->second;
+    for(callback_info_t& entry : watch->callbacks)
     {
-      if(pos->second.flags & flags) // if only some flags match
+      entry.flags &= ~flags; // remove flags (callback may be executing so it's only freed later)
+      remaining_flags |= entry.flags; // accumulate remaining flags
+    }
+
+    if(!watch->dirty) // schedule removal of callbacks without flags
+    {
+      watch->dirty = true;
+      m_dirty.push_back(watch);
+    }
+  }
+
+  bool rval = remaining_flags
+      ? platform->add(fd, remaining_flags, iter->second)
+      : platform->remove(fd, iter == queue.end() ? nullptr : iter->second);
+  queue.unlock(); // access is no longer needed
+  return rval;
+}
+
+bool EventBackend::instance_t::rearm(posix::fd_t fd) noexcept
+{
+  native_flags_t total_flags = 0;
+  bool rval = false;
+  queue.lock(); // get exclusive access (make thread-safe)
+  auto iter = queue.find(fd);
+  if(iter != queue.end())
+  {
+    for(callback_info_t& entry : iter->second->callbacks)
+      total_flags |= entry.flags;
+    rval = total_flags && platform->add(fd, total_flags, iter->second);
+  }
+  queue.unlock(); // access is no longer needed
+  return rval;
+}
+
+void EventBackend::instance_t::dispatch(void) noexcept
+{
+  for(result_t& result : results) // process results
+    for(callback_info_t& entry : result.watch->callbacks) // for each callback of the FD
+      if(entry.flags & result.flags) // check if there is a matching flag
+        entry.function(result.watch->fd, result.flags); // invoke the callback function with the FD and triggering Flag
+}
+
+void EventBackend::instance_t::collect(void) noexcept
+{
+  queue.lock(); // get exclusive access (make thread-safe)
+  if(m_dirty.empty())
+  {
+    queue.unlock(); // access is no longer needed
+    return;
+  }
+
+  std::vector<watch_t*> remaining;
+  for(watch_t* watch : m_dirty)
+  {
+    watch->callbacks.remove_if([](const callback_info_t& entry) noexcept { return !entry.flags; });
+    watch->dirty = false;
+    if(watch->callbacks.empty()) // nothing left to watch
+    {
+      if(watch->pending) // the backend may still report it
       {
-        pos->second.flags ^= pos->second.flags & flags; // remove flags
-        remaining_flags |= pos->second.flags; // accumulate remaining flags
+        watch->dirty = true;
+        remaining.push_back(watch);
+      }
+      else
+      {
+        auto iter = queue.find(watch->fd);
+        if(iter != queue.end() && iter->second == watch) // FD may be watched by a newer watch
+          queue.erase(iter);
+        platform->release(watch);
+        delete watch;
       }
-      ++pos;
     }
   }
-  return remaining_flags
-      ? s_platform.add(fd, remaining_flags)
-      : s_platform.remove(fd);
+  m_dirty.clear();
+  m_dirty.insert(m_dirty.end(), remaining.begin(), remaining.end());
+  queue.unlock(); // access is no longer needed
 }
-
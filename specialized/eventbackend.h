@@ -6,6 +6,7 @@
 #include <functional>
 #include <unordered_map>
 #include <list>
+#include <vector>
 
 // PUT
 #include <put/cxxutils/posix_helpers.h>
@@ -19,19 +20,66 @@ namespace EventBackend
   using callback_t = std::function<void(posix::fd_t, native_flags_t) noexcept>;
   struct callback_info_t
   {
-    native_flags_t flags;
+    native_flags_t flags; // 0 once removed
     callback_t function;
   };
 
-  extern bool add(posix::fd_t target, native_flags_t flags, callback_t function) noexcept; // add FD to montior
-  extern bool remove(posix::fd_t target, native_flags_t flags) noexcept; // remove from watch queue
+  struct watch_t // everything watched for a single FD (referenced directly by native events)
+  {
+    posix::fd_t fd;
+    std::list<callback_info_t> callbacks; // list so callbacks can be added while executing
+    bool dirty; // has removed callbacks
+    bool registered; // FD has been added to the native backend
+    uint32_t pending; // native requests that may still report this watch (io_uring)
+    uint64_t key; // native event data that leads back to this watch (epoll)
+  };
+
+  struct result_t
+  {
+    watch_t* watch;
+    native_flags_t flags;
+  };
+
+  struct platform_dependant;
+
+  // a single event backend (one per event loop)
+  struct instance_t
+  {
+    instance_t(void) noexcept;
+    ~instance_t(void) noexcept;
+
+    bool add(posix::fd_t target, native_flags_t flags, callback_t function) noexcept; // add FD to montior
+    bool remove(posix::fd_t target, native_flags_t flags) noexcept; // remove from watch queue
+    bool rearm(posix::fd_t target) noexcept; // reenable a oneshot FD with it's current flags
+
+    bool poll(milliseconds_t timeout = -1) noexcept;
+    void dispatch(void) noexcept; // invoke the callbacks matching every result
+
+    posix::lockable<std::unordered_map<posix::fd_t, watch_t*>> queue; // watch queue (only searched when adding/removing)
+    std::vector<result_t> results; // results from getevents() (never reallocated)
+
+    platform_dependant* platform;
+
+  private:
+    void collect(void) noexcept; // free removed callbacks (no results refer to them)
+    std::vector<watch_t*> m_dirty;
+  };
+
+  extern instance_t& current(void) noexcept; // backend used by the calling thread
+  extern void setCurrent(instance_t* instance) noexcept; // set backend used by the calling thread (nullptr for default)
+
+  static inline bool add(posix::fd_t target, native_flags_t flags, callback_t function) noexcept // add FD to montior
+    { return current().add(target, flags, function); }
+
+  static inline bool remove(posix::fd_t target, native_flags_t flags) noexcept // remove from watch queue
+    { return current().remove(target, flags); }
 
-  extern bool poll(milliseconds_t timeout = -1) noexcept;
+  static inline bool rearm(posix::fd_t target) noexcept // reenable a oneshot FD with it's current flags
+    { return current().rearm(target); }
 
-  extern posix::lockable<std::unordered_multimap<posix::fd_t, callback_info_t>> queue; // watch queue
-  extern std::list<std::pair<posix::fd_t, native_flags_t>> results; // results from getevents()
+  static inline bool poll(milliseconds_t timeout = -1) noexcept
+    { return current().poll(timeout); }
 
-  extern struct platform_dependant s_platform;
   extern const native_flags_t SimplePollReadFlags;
 }
 
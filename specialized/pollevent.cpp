@@ -24,13 +24,20 @@ static constexpr uint8_t from_native_flags(const native_flags_t flags) noexcept
       (flags & EPOLLOUT ? PollEvent::Writeable      : 0);
 }
 
+# if !defined(EPOLLEXCLUSIVE) // Linux 4.5+
+#  define EPOLLEXCLUSIVE 0
+# endif
+
 static constexpr native_flags_t to_native_flags(const uint8_t flags) noexcept
 {
   return
-      (flags & PollEvent::Error        ? native_flags_t(EPOLLERR ) : 0) |
-      (flags & PollEvent::Disconnected ? native_flags_t(EPOLLHUP ) : 0) |
-      (flags & PollEvent::Readable     ? native_flags_t(EPOLLIN  ) : 0) |
-      (flags & PollEvent::Writeable    ? native_flags_t(EPOLLOUT ) : 0);
+      (flags & PollEvent::Error         ? native_flags_t(EPOLLERR      ) : 0) |
+      (flags & PollEvent::Disconnected  ? native_flags_t(EPOLLHUP      ) : 0) |
+      (flags & PollEvent::Readable      ? native_flags_t(EPOLLIN       ) : 0) |
+      (flags & PollEvent::Writeable     ? native_flags_t(EPOLLOUT      ) : 0) |
+      (flags & PollEvent::EdgeTriggered ? native_flags_t(EPOLLET       ) : 0) |
+      (flags & PollEvent::OneShot       ? native_flags_t(EPOLLONESHOT  ) : 0) |
+      (flags & PollEvent::Exclusive     ? native_flags_t(EPOLLEXCLUSIVE) : 0);
 }
 
 #elif defined(__darwin__)     /* Darwin 7+     */ || \
@@ -63,7 +70,9 @@ static constexpr native_flags_t to_native_flags(const uint8_t flags) noexcept
       (flags & PollEvent::Error         ? composite_flag(EV_ERROR, 0           , 0) : 0) |
       (flags & PollEvent::Disconnected  ? composite_flag(EV_EOF  , 0           , 0) : 0) |
       (flags & PollEvent::Readable      ? composite_flag(0       , EVFILT_READ , 0) : 0) |
-      (flags & PollEvent::Writeable     ? composite_flag(0       , EVFILT_WRITE, 0) : 0) ;
+      (flags & PollEvent::Writeable     ? composite_flag(0       , EVFILT_WRITE, 0) : 0) |
+      (flags & PollEvent::EdgeTriggered ? composite_flag(EV_CLEAR  , 0         , 0) : 0) |
+      (flags & PollEvent::OneShot       ? composite_flag(EV_ONESHOT, 0         , 0) : 0) ;
 }
 
 #elif defined(__solaris__) /* Solaris */
@@ -119,12 +128,31 @@ static constexpr native_flags_t to_native_flags(const uint8_t flags) noexcept
 PollEvent::PollEvent(posix::fd_t _fd, Flags_t _flags) noexcept
   : m_fd(_fd), m_flags(_flags)
 {
-  EventBackend::add(m_fd, to_native_flags(m_flags), // connect FD with flags to signal
-                    [this](posix::fd_t lambda_fd, native_flags_t lambda_flags) noexcept
-                    { Object::enqueue_copy<posix::fd_t, Flags_t>(activated, lambda_fd, from_native_flags(lambda_flags)); });
+  watch();
+}
+
+bool PollEvent::watch(void) noexcept
+{
+  return EventBackend::add(m_fd, to_native_flags(m_flags), // connect FD with flags to signal
+                           [this](posix::fd_t lambda_fd, native_flags_t lambda_flags) noexcept
+                           { Object::enqueue_copy<posix::fd_t, Flags_t>(activated, lambda_fd, from_native_flags(lambda_flags)); });
 }
 
 PollEvent::~PollEvent(void) noexcept
 {
   EventBackend::remove(m_fd, to_native_flags(m_flags)); // disconnect FD with flags from signal
 }
+
+bool PollEvent::rearm(void) noexcept
+{
+  return EventBackend::rearm(m_fd);
+}
+
+bool PollEvent::setFlags(Flags_t flags) noexcept
+{
+  if(flags == m_flags)
+    return true;
+  EventBackend::remove(m_fd, to_native_flags(m_flags));
+  m_flags = flags;
+  return watch();
+}
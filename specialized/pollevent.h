@@ -15,6 +15,11 @@ public:
     Readable      = 0x04, // FD has content to read
     Writeable     = 0x08, // FD is writeable
     Any           = 0x0F, // Any FD event
+
+    // modes
+    EdgeTriggered = 0x10, // only activate when the FD changes state (read until EAGAIN)
+    OneShot       = 0x20, // disable the FD after it activates until rearm() is called
+    Exclusive     = 0x40, // only one of the event loops watching the FD is activated (epoll only: fails with EOPNOTSUPP on io_uring, ignored elsewhere)
   };
 
   struct Flags_t
@@ -23,6 +28,9 @@ public:
     uint8_t Disconnected  : 1;
     uint8_t Readable      : 1;
     uint8_t Writeable     : 1;
+    uint8_t EdgeTriggered : 1;
+    uint8_t OneShot       : 1;
+    uint8_t Exclusive     : 1;
 
     Flags_t(uint8_t flags = 0) noexcept { *reinterpret_cast<uint8_t*>(this) = flags; }
     operator const uint8_t& (void) const noexcept { return *reinterpret_cast<const uint8_t*>(this); }
@@ -34,10 +42,16 @@ public:
   posix::fd_t fd(void) const noexcept { return m_fd; }
   Flags_t flags(void) const noexcept { return m_flags; }
 
+  bool rearm(void) noexcept; // reenable a OneShot FD
+  bool setFlags(Flags_t flags) noexcept; // change the events and mode being watched
+
   signal<posix::fd_t, Flags_t> activated;
 protected:
   posix::fd_t m_fd;
   Flags_t m_flags;
+
+private:
+  bool watch(void) noexcept;
 };
 
 #endif
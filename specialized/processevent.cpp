@@ -14,6 +14,15 @@
 #include <linux/netlink.h>
 #include <linux/connector.h>
 #include <linux/cn_proc.h>
+#include <linux/filter.h>
+
+// STL
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+
+// POSIX
+#include <sys/wait.h>
 
 // PUT
 # include <put/cxxutils/posix_helpers.h>
@@ -38,6 +47,41 @@ static constexpr native_flags_t to_native_flags(const uint8_t flags) noexcept
 }
 */
 
+// queues the signal for a decoded event
+static void dispatch(ProcessEvent& target, const proc_event& data) noexcept
+{
+  if(data.what == proc_event::PROC_EVENT_NONE &&
+     data.event_data.ack.err == ENOBUFS) // events were dropped
+    Object::enqueue_copy(target.overflowed, target.pid());
+
+  uint8_t type = from_native_flags(data.what);
+  if(!(type & target.flags())) // not subscribed to this type of event (AnyProcess subscribers receive every event)
+    return;
+
+  switch(type) // find the type of event
+  {
+    case ProcessEvent::Exec: // queue exec signal with PID
+      Object::enqueue_copy(target.execed,
+                           pid_t(data.event_data.exec.process_pid));
+      break;
+    case ProcessEvent::Exit: // queue exit signal with PID and exit code
+      if(WIFSIGNALED(data.event_data.exit.exit_code)) // if killed by a signal (exit_signal is the signal sent to the parent)
+        Object::enqueue_copy(target.killed,
+                             pid_t(data.event_data.exit.process_pid),
+                             posix::Signal::EId(WTERMSIG(data.event_data.exit.exit_code)));
+      else // else exited by itself
+        Object::enqueue_copy(target.exited,
+                             pid_t(data.event_data.exit.process_pid),
+                             posix::error_t(WEXITSTATUS(data.event_data.exit.exit_code)));
+      break;
+    case ProcessEvent::Fork: // queue fork signal with PID and child PID
+      Object::enqueue_copy(target.forked,
+                           pid_t(data.event_data.fork.parent_pid),
+                           pid_t(data.event_data.fork.child_pid));
+      break;
+  }
+}
+
 struct ProcessEvent::platform_dependant // process notification (process events connector)
 {
   enum {
@@ -45,6 +89,19 @@ struct ProcessEvent::platform_dependant // process notification (process events
     Write = 1,
   };
 
+  enum : int
+  {
+    ReceiveBufferSize = 4 * 1024 * 1024, // absorbs bursts of events between reads
+    Batch = 64, // messages read with each recvmmsg()
+    MessageSize = 512, // larger than any proc connector message
+  };
+
+  enum : uint32_t
+  {
+    PidOffset = NLMSG_HDRLEN + offsetof(cn_msg, data) + offsetof(proc_event, event_data), // first field of every event (the parent for fork)
+    FilterPidLimit = (BPF_MAXINSNS - 2) / 2, // more pids than this are not filtered
+  };
+
   bool permitted;
   posix::fd_t fd;
   struct eventinfo_t
@@ -54,6 +111,13 @@ struct ProcessEvent::platform_dependant // process notification (process events
   };
 
   std::unordered_map<pid_t, eventinfo_t> events;
+  std::vector<ProcessEvent*> wildcards; // AnyProcess subscribers (signals are queued directly)
+
+  struct alignas(NLMSG_ALIGNTO) message_t { uint8_t data[MessageSize]; };
+  message_t messages[Batch];
+  iovec vectors[Batch];
+  mmsghdr headers[Batch];
+  std::vector<sock_filter> program; // socket filter for the watched pids
 
   platform_dependant(void) noexcept
   {
@@ -67,6 +131,18 @@ struct ProcessEvent::platform_dependant // process notification (process events
     sa_nl.nl_groups = CN_IDX_PROC;
     sa_nl.nl_pid = uint32_t(getpid());
 
+    if(!posix::setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, ReceiveBufferSize)) // exceeding rmem_max requires CAP_NET_ADMIN
+      posix::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, ReceiveBufferSize);
+
+    posix::memset(headers, 0, sizeof(headers));
+    for(int i = 0; i < Batch; ++i)
+    {
+      vectors[i].iov_base = messages[i].data;
+      vectors[i].iov_len = MessageSize;
+      headers[i].msg_hdr.msg_iov = &vectors[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
     permitted = posix::bind(fd, reinterpret_cast<struct sockaddr *>(&sa_nl), sizeof(sa_nl));
     if(!permitted)
     {
@@ -77,29 +153,27 @@ struct ProcessEvent::platform_dependant // process notification (process events
     }
     else
     {
-#pragma pack(push, 1)
-      struct alignas(NLMSG_ALIGNTO) procconn_t // 32-bit alignment
-      {
-        nlmsghdr header; // 16 bytes
-        cn_msg message;
-        proc_cn_mcast_op operation;
-      } procconn;
-#pragma pack(pop)
-      static_assert(sizeof(nlmsghdr) + sizeof(cn_msg) + sizeof(proc_cn_mcast_op) == sizeof(procconn_t), "compiler needs to pack struct");
-
-      posix::memset(&procconn, 0, sizeof(procconn));
-      procconn.header.nlmsg_len = sizeof(procconn);
-      procconn.header.nlmsg_pid = uint32_t(getpid());
-      procconn.header.nlmsg_type = NLMSG_DONE;
-      procconn.message.id.idx = CN_IDX_PROC;
-      procconn.message.id.val = CN_VAL_PROC;
-      procconn.message.len = sizeof(proc_cn_mcast_op);
-      procconn.operation = PROC_CN_MCAST_LISTEN;
+      // cn_msg ends with a flexible array so the request is laid out in a buffer
+      alignas(NLMSG_ALIGNTO) uint8_t procconn[NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))];
+      nlmsghdr* header = reinterpret_cast<nlmsghdr*>(procconn);
+      cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+      proc_cn_mcast_op operation = PROC_CN_MCAST_LISTEN;
+
+      posix::memset(procconn, 0, sizeof(procconn));
+      header->nlmsg_len = sizeof(procconn);
+      header->nlmsg_pid = uint32_t(getpid());
+      header->nlmsg_type = NLMSG_DONE;
+      message->id.idx = CN_IDX_PROC;
+      message->id.val = CN_VAL_PROC;
+      message->len = sizeof(proc_cn_mcast_op);
+      posix::memcpy(message->data, &operation, sizeof(operation));
 
       flaw(posix::send(fd, &procconn, sizeof(procconn)) == posix::error_response,
            terminal::warning,,,
            "Failed to enable Process Events Connector notifications: %s", posix::strerror(errno));
 
+      filter(); // nothing is watched yet so every event is dropped by the kernel
+
       EventBackend::add(fd, EventBackend::SimplePollReadFlags,
                         [this](posix::fd_t lambda_fd, native_flags_t) noexcept { read(lambda_fd); });
 
@@ -128,11 +202,25 @@ struct ProcessEvent::platform_dependant // process notification (process events
     posix::fcntl(data.fd[Read ], F_SETFD, FD_CLOEXEC); // close on exec*()
     posix::fcntl(data.fd[Write], F_SETFD, FD_CLOEXEC); // close on exec*()
 
-    auto iter = events.emplace(pid, data);
+    events.emplace(pid, data);
+    filter();
+    return data.fd[Read];
+  }
 
-    // add Berkeley Packet Filter installation code here
+  bool subscribe(ProcessEvent* target) noexcept
+  {
+    if(!permitted)
+      return false;
+    wildcards.push_back(target);
+    filter();
+    return true;
+  }
 
-    return data.fd[Read];
+  void unsubscribe(ProcessEvent* target) noexcept
+  {
+    wildcards.erase(std::remove(wildcards.begin(), wildcards.end(), target), wildcards.end());
+    if(permitted)
+      filter();
   }
 
   bool remove(pid_t pid) noexcept
@@ -141,76 +229,153 @@ struct ProcessEvent::platform_dependant // process notification (process events
     if(!permitted || iter == events.end())
       return false;
 
-    // add Berkeley Packet Filter removal code here
-
     posix::close(iter->second.fd[Read]);
     posix::close(iter->second.fd[Write]);
     events.erase(iter);
+    filter();
     return true;
   }
 
-  void read(posix::fd_t procfd) noexcept
+  // rebuilds the socket filter so the kernel drops events for pids nobody watches
+  // program: load pid, then "if pid == watched: accept" for each watched pid, else drop
+  void filter(void) noexcept
   {
-#pragma pack(push, 1)
-    struct alignas(NLMSG_ALIGNTO) procmsg_t // 32-bit alignment
+    if(!wildcards.empty() || events.size() > FilterPidLimit) // every event is needed (or too many pids)
     {
-      nlmsghdr header; // 16 bytes
-      cn_msg message;
-      proc_event event;
-    } procmsg;
-#pragma pack(pop)
-    static_assert(sizeof(nlmsghdr) + sizeof(cn_msg) + sizeof(proc_event) == sizeof(procmsg_t), "compiler needs to pack struct");
-
-    pollfd fds = { procfd, POLLIN, 0 };
-    while(posix::poll(&fds, 1, 0) > 0 && // while there are messages AND
-          posix::recv(procfd, reinterpret_cast<void*>(&procmsg), sizeof(procmsg_t), 0) > 0) // read process event message
+      int unused = 0;
+      flaw(::setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused)) == posix::error_response &&
+           errno != posix::errc::no_such_file_or_directory, // no filter was attached
+           terminal::warning,,,
+           "Unable to detach Process Events Connector socket filter: %s", posix::strerror(errno))
+      errno = posix::success_response; // clear error
+      return;
+    }
+
+    program.clear(); // capacity is kept so rebuilds don't allocate
+    program.push_back(sock_filter BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, PidOffset));
+    for(auto& pair : events) // each test only skips its own accept so jump offsets stay within 8 bits
     {
-      auto iter = events.find(procmsg.event.event_data.id.process_pid); // find event info for this PID
+      program.push_back(sock_filter BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(uint32_t(pair.first)), 0, 1));
+      program.push_back(sock_filter BPF_STMT(BPF_RET | BPF_K, UINT32_MAX)); // accept whole datagram
+    }
+    program.push_back(sock_filter BPF_STMT(BPF_RET | BPF_K, 0)); // drop
+
+    sock_fprog code = { uint16_t(program.size()), program.data() };
+    flaw(::setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &code, sizeof(code)) == posix::error_response,
+         terminal::warning,,,
+         "Unable to attach Process Events Connector socket filter: %s", posix::strerror(errno))
+  }
+
+  // reports events that the kernel dropped because the socket's receive buffer was full
+  void overflow(void) noexcept
+  {
+    proc_event marker;
+    posix::memset(&marker, 0, sizeof(marker));
+    marker.what = proc_event::PROC_EVENT_NONE;
+    marker.event_data.ack.err = ENOBUFS;
+    for(auto& pair : events)
+      posix::write(pair.second.fd[Write], &marker, sizeof(marker));
+    for(ProcessEvent* target : wildcards)
+      dispatch(*target, marker);
+  }
+
+  // only process (not thread) events are reported to AnyProcess
+  static bool process_event(const proc_event& event) noexcept
+  {
+    switch(event.what)
+    {
+      case proc_event::PROC_EVENT_FORK: return event.event_data.fork.child_pid == event.event_data.fork.child_tgid;
+      case proc_event::PROC_EVENT_EXEC: return true;
+      case proc_event::PROC_EVENT_EXIT: return event.event_data.exit.process_pid == event.event_data.exit.process_tgid;
+      default: return false;
+    }
+  }
+
+  void deliver(const proc_event& event) noexcept
+  {
+    if(!events.empty())
+    {
+      auto iter = events.find(event.event_data.id.process_pid); // find event info for this PID
       if(iter != events.end()) // if found...
-        posix::write(iter->second.fd[Write], &procmsg.event, sizeof(procmsg.event)); // write process event info into the communications pipe
+        posix::write(iter->second.fd[Write], &event, sizeof(event)); // write process event info into the communications pipe
+    }
+    if(!wildcards.empty() && process_event(event))
+      for(ProcessEvent* target : wildcards)
+        dispatch(*target, event);
+  }
+
+  void read(posix::fd_t procfd) noexcept
+  {
+    proc_event event;
+    for(;;) // until the socket is drained
+    {
+#if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,6,33) /* Linux 2.6.33+ */
+      int count = ::recvmmsg(procfd, headers, Batch, MSG_DONTWAIT, nullptr);
+#else
+      posix::ssize_t length = posix::recv(procfd, messages[0].data, MessageSize, MSG_DONTWAIT);
+      headers[0].msg_len = length < 0 ? 0 : unsigned(length);
+      int count = length < 0 ? posix::error_response : 1;
+#endif
+      if(count <= 0)
+      {
+        if(count == posix::error_response &&
+           errno == posix::errc::no_buffer_space) // the kernel dropped events
+        {
+          overflow();
+          continue;
+        }
+        break;
+      }
+
+      for(int i = 0; i < count; ++i) // each datagram holds one or more netlink messages
+      {
+        uint32_t remaining = headers[i].msg_len;
+        for(const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(messages[i].data);
+            NLMSG_OK(header, remaining);
+            header = NLMSG_NEXT(header, remaining))
+        {
+          const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+          if(header->nlmsg_type != NLMSG_DONE ||
+             message->id.idx != CN_IDX_PROC ||
+             message->len < sizeof(event))
+            continue;
+          posix::memcpy(&event, message->data, sizeof(event)); // cn_msg data is not aligned for proc_event
+          deliver(event);
+        }
+      }
+
+      if(count < Batch) // drained
+        break;
     }
   }
 } ProcessEvent::s_platform;
 
 ProcessEvent::ProcessEvent(pid_t _pid, Flags_t _flags) noexcept
-  : m_pid(_pid), m_flags(_flags), m_fd(posix::invalid_descriptor)
+  : m_pid(_pid), m_flags(_flags), m_fd(posix::invalid_descriptor), m_active(false)
 {
+  if(m_pid == AnyProcess) // signals are queued straight from the connector socket
+  {
+    m_active = s_platform.subscribe(this);
+    return;
+  }
+
   m_fd = s_platform.add(m_pid, m_flags); // add PID to monitor and return communications pipe
   if(m_fd != posix::invalid_descriptor)
-    EventBackend::add(m_fd, EventBackend::SimplePollReadFlags, // connect communications pipe to a lambda function
+    m_active = EventBackend::add(m_fd, EventBackend::SimplePollReadFlags, // connect communications pipe to a lambda function
                       [this](posix::fd_t lambda_fd, native_flags_t) noexcept
                       {
                         proc_event data;
                         pollfd fds = { lambda_fd, POLLIN, 0 };
                         while(posix::poll(&fds, 1, 0) > 0 && // while there is another event to be read
                               posix::read(lambda_fd, &data, sizeof(data)) > 0) // read the event
-                          switch(from_native_flags(data.what)) // find the type of event
-                          {
-                            case Flags::Exec: // queue exec signal with PID
-                              Object::enqueue(execed,
-                                              data.event_data.exec.process_pid);
-                              break;
-                            case Flags::Exit: // queue exit signal with PID and exit code
-                              if(data.event_data.exit.exit_signal) // if killed by a signal
-                                Object::enqueue(killed,
-                                                data.event_data.exit.process_pid,
-                                                *reinterpret_cast<posix::Signal::EId*>(&data.event_data.exit.exit_signal));
-                              else // else exited by itself
-                                Object::enqueue(exited,
-                                                data.event_data.exit.process_pid,
-                                                *reinterpret_cast<posix::error_t*>(&data.event_data.exit.exit_code));
-                              break;
-                            case Flags::Fork: // queue fork signal with PID and child PID
-                              Object::enqueue(forked,
-                                              data.event_data.fork.parent_pid,
-                                              data.event_data.fork.child_pid);
-                              break;
-                          }
+                          dispatch(*this, data);
                       });
 }
 
 ProcessEvent::~ProcessEvent(void) noexcept
 {
+  if(m_pid == AnyProcess)
+    s_platform.unsubscribe(this);
   if(m_fd != posix::invalid_descriptor)
   {
     EventBackend::remove(m_fd, EventBackend::SimplePollReadFlags);
@@ -248,9 +413,10 @@ static constexpr rtype extract_flags(native_flags_t flags) noexcept
   { return flags >> 32; }
 
 ProcessEvent::ProcessEvent(pid_t _pid, Flags_t _flags) noexcept
-  : m_pid(_pid), m_flags(_flags), m_fd(posix::invalid_descriptor)
+  : m_pid(_pid), m_flags(_flags), m_fd(posix::invalid_descriptor), m_active(false)
 {
-  EventBackend::add(m_pid, to_native_flags(m_flags), // connect PID event to lambda function
+  if(m_pid != AnyProcess) // kqueue can only watch individual processes
+    m_active = EventBackend::add(m_pid, to_native_flags(m_flags), // connect PID event to lambda function
                     [this](posix::fd_t lambda_fd, native_flags_t lambda_flags) noexcept
                     {
                       switch(extract_filter(lambda_flags)) // switch by filtered event type
@@ -270,7 +436,8 @@ ProcessEvent::ProcessEvent(pid_t _pid, Flags_t _flags) noexcept
 
 ProcessEvent::~ProcessEvent(void) noexcept
 {
-  EventBackend::remove(m_pid, to_native_flags(m_flags)); // disconnect PID with flags
+  if(m_active)
+    EventBackend::remove(m_pid, to_native_flags(m_flags)); // disconnect PID with flags
 }
 
 #elif defined(__solaris__) /* Solaris */
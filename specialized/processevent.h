@@ -26,20 +26,28 @@ public:
     operator const uint8_t& (void) const noexcept { return *reinterpret_cast<const uint8_t*>(this); }
   };
 
+  enum : pid_t
+  {
+    AnyProcess = 0, // watch every process (thread events are not reported)
+  };
+
   ProcessEvent(pid_t _pid, Flags_t _flags) noexcept;
   ~ProcessEvent(void) noexcept;
 
   pid_t pid(void) const noexcept { return m_pid; }
   Flags_t flags(void) const noexcept { return m_flags; }
+  bool isActive(void) const noexcept { return m_active; } // events are being delivered
 
   signal<pid_t, posix::error_t    > exited; // exit signal with PID and process exit code
   signal<pid_t, posix::Signal::EId> killed; // killed signal with PID and signal number
   signal<pid_t, pid_t             > forked; // fork signal with PID and child PID
   signal<pid_t                    > execed; // exec signal with PID
+  signal<pid_t                    > overflowed; // the kernel dropped events (state must be rescanned)
 private:
   pid_t m_pid;
   Flags_t m_flags;
   posix::fd_t m_fd;
+  bool m_active;
 
   struct platform_dependant;
   static struct platform_dependant s_platform;
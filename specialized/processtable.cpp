@@ -0,0 +1,273 @@
+#include "processtable.h"
+
+// STL
+#include <algorithm>
+
+// PUT
+#include <put/specialized/osdetect.h>
+
+#if defined(__linux__) /* Linux */
+// POSIX
+# include <dirent.h>
+
+// PUT
+# include <put/specialized/mountpoints.h>
+#else
+// PUT
+# include <put/specialized/proclist.h>
+#endif
+
+template<typename T>
+static void reorder(std::vector<T>& column, const std::vector<uint32_t>& order) noexcept
+{
+  std::vector<T> sorted;
+  sorted.reserve(column.size());
+  for(uint32_t row : order)
+    sorted.push_back(column[row]);
+  column.swap(sorted);
+}
+
+static inline uint64_t microseconds(const timeval& value) noexcept
+  { return uint64_t(value.tv_sec) * 1000000 + uint64_t(value.tv_usec); }
+
+bool ProcessTable::refresh(void) noexcept
+{
+  m_pids.clear(); // capacity is kept so later refreshes don't allocate
+  m_ppids.clear();
+  m_states.clear();
+  m_utimes.clear();
+  m_stimes.clear();
+  m_rss.clear();
+  m_names.clear();
+  m_stale.clear();
+
+  process_sample_t sample;
+#if defined(__linux__)
+  if(procfs_path == nullptr) // safety check
+    return false;
+
+  DIR* dirp = ::opendir(procfs_path);
+  if(dirp == NULL)
+    return false;
+
+  struct dirent* entry;
+  while((entry = ::readdir(dirp)) != NULL)
+  {
+    pid_t pid = posix::atoi(entry->d_name);
+    if(entry->d_type == DT_DIR && pid > 0 &&
+       procstat(pid, sample)) // skips processes that exit during the sweep
+      append(sample);
+  }
+
+  if(::closedir(dirp) == posix::error_response)
+    return false;
+#else
+  std::set<pid_t> list;
+  if(!proclist(list))
+    return false;
+
+  for(pid_t pid : list)
+    if(procstat(pid, sample))
+      append(sample);
+#endif
+
+  if(!std::is_sorted(m_pids.begin(), m_pids.end())) // procfs lists processes by pid so this is rare
+  {
+    std::vector<uint32_t> order(m_pids.size());
+    for(uint32_t row = 0; row < order.size(); ++row)
+      order[row] = row;
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) noexcept { return m_pids[a] < m_pids[b]; });
+    reorder(m_pids, order);
+    reorder(m_ppids, order);
+    reorder(m_states, order);
+    reorder(m_utimes, order);
+    reorder(m_stimes, order);
+    reorder(m_rss, order);
+    reorder(m_names, order);
+    reorder(m_stale, order);
+  }
+  return true;
+}
+
+posix::ssize_t ProcessTable::indexOf(pid_t pid) const noexcept
+{
+  auto pos = std::lower_bound(m_pids.begin(), m_pids.end(), pid);
+  if(pos == m_pids.end() || *pos != pid)
+    return posix::error_response;
+  return pos - m_pids.begin();
+}
+
+void ProcessTable::append(const process_sample_t& sample) noexcept
+{
+  m_pids.push_back(sample.process_id);
+  m_ppids.push_back(sample.parent_process_id);
+  m_states.push_back(sample.state);
+  m_utimes.push_back(microseconds(sample.user_time));
+  m_stimes.push_back(microseconds(sample.system_time));
+  m_rss.push_back(sample.memory_size.rss);
+  m_names.push_back(intern(sample.name));
+  m_stale.push_back(0);
+}
+
+ProcessTable::name_id_t ProcessTable::intern(const char* name) noexcept
+{
+  std::string key(name); // names fit in the small string buffer
+  auto pos = m_name_ids.find(key);
+  if(pos != m_name_ids.end())
+    return pos->second;
+
+  name_id_t id = name_id_t(m_name_pool.size());
+  m_name_pool.emplace_back(key);
+  m_name_ids.emplace(std::move(key), id);
+  return id;
+}
+
+bool ProcessTable::update(pid_t pid) noexcept
+{
+  process_sample_t sample;
+  posix::ssize_t row = indexOf(pid);
+  if(!procstat(pid, sample))
+  {
+    if(row != posix::error_response &&
+       (errno == posix::errc::no_such_file_or_directory ||
+        errno == posix::errc::no_such_process)) // exited
+      eraseRow(posix::size_t(row));
+    return false;
+  }
+
+  if(row == posix::error_response)
+    row = posix::ssize_t(insertRow(pid));
+  assign(posix::size_t(row), sample);
+  return true;
+}
+
+void ProcessTable::insert(pid_t pid, pid_t parent) noexcept
+{
+  posix::ssize_t row = indexOf(pid);
+  if(row == posix::error_response) // may already be present from a refresh
+    row = posix::ssize_t(insertRow(pid));
+
+  posix::ssize_t parent_row = indexOf(parent);
+  m_ppids[row] = parent;
+  m_states[row] = Running;
+  m_utimes[row] = 0;
+  m_stimes[row] = 0;
+  if(parent_row != posix::error_response) // fork() copies the name and memory of the parent
+  {
+    m_names[row] = m_names[parent_row];
+    m_rss[row] = m_rss[parent_row];
+  }
+  m_stale[row] = 1;
+}
+
+void ProcessTable::invalidate(pid_t pid) noexcept
+{
+  posix::ssize_t row = indexOf(pid);
+  if(row != posix::error_response)
+    m_stale[row] = 1;
+}
+
+bool ProcessTable::erase(pid_t pid) noexcept
+{
+  posix::ssize_t row = indexOf(pid);
+  if(row == posix::error_response)
+    return false;
+  eraseRow(posix::size_t(row));
+  return true;
+}
+
+void ProcessTable::assign(posix::size_t row, const process_sample_t& sample) noexcept
+{
+  m_ppids[row] = sample.parent_process_id;
+  m_states[row] = sample.state;
+  m_utimes[row] = microseconds(sample.user_time);
+  m_stimes[row] = microseconds(sample.system_time);
+  m_rss[row] = sample.memory_size.rss;
+  m_names[row] = intern(sample.name);
+  m_stale[row] = 0;
+}
+
+posix::size_t ProcessTable::insertRow(pid_t pid) noexcept
+{
+  auto pos = std::lower_bound(m_pids.begin(), m_pids.end(), pid);
+  posix::size_t row = posix::size_t(pos - m_pids.begin());
+  m_pids.insert(pos, pid);
+  m_ppids.insert(m_ppids.begin() + row, 0);
+  m_states.insert(m_states.begin() + row, Invalid);
+  m_utimes.insert(m_utimes.begin() + row, 0);
+  m_stimes.insert(m_stimes.begin() + row, 0);
+  m_rss.insert(m_rss.begin() + row, 0);
+  m_names.insert(m_names.begin() + row, intern(""));
+  m_stale.insert(m_stale.begin() + row, 1);
+  return row;
+}
+
+void ProcessTable::eraseRow(posix::size_t row) noexcept
+{
+  m_pids.erase(m_pids.begin() + row);
+  m_ppids.erase(m_ppids.begin() + row);
+  m_states.erase(m_states.begin() + row);
+  m_utimes.erase(m_utimes.begin() + row);
+  m_stimes.erase(m_stimes.begin() + row);
+  m_rss.erase(m_rss.begin() + row);
+  m_names.erase(m_names.begin() + row);
+  m_stale.erase(m_stale.begin() + row);
+}
+
+LiveProcessTable::LiveProcessTable(milliseconds_t rescan_interval) noexcept
+  : m_events(ProcessEvent::AnyProcess, ProcessEvent::Any)
+{
+  Object::connect(m_events.forked    , this, &LiveProcessTable::forkEvent);
+  Object::connect(m_events.execed    , this, &LiveProcessTable::execEvent);
+  Object::connect(m_events.exited    , this, &LiveProcessTable::exitEvent);
+  Object::connect(m_events.killed    , this, &LiveProcessTable::killEvent);
+  Object::connect(m_events.overflowed, this, &LiveProcessTable::overflowEvent);
+  Object::connect(m_rescan.expired   , this, &LiveProcessTable::rescanEvent);
+
+  m_table.refresh(); // events are already being received so nothing is missed
+  if(!m_events.isActive()) // without events the table can only be kept current by rescanning
+    m_rescan.start(rescan_interval, true);
+}
+
+bool LiveProcessTable::rescan(void) noexcept
+{
+  m_previous = m_table.pids();
+  if(!m_table.refresh())
+    return false;
+
+  // both lists are ordered by pid so one merge pass finds every difference
+  const std::vector<pid_t>& current = m_table.pids();
+  auto before = m_previous.begin();
+  auto after = current.begin();
+  while(before != m_previous.end() || after != current.end())
+  {
+    if(after == current.end() || (before != m_previous.end() && *before < *after))
+      Object::enqueue_copy(removed, *before++);
+    else if(before == m_previous.end() || *after < *before)
+    {
+      Object::enqueue_copy(added, *after, m_table.parentPids()[posix::size_t(after - current.begin())]);
+      ++after;
+    }
+    else
+      ++before, ++after;
+  }
+  return true;
+}
+
+void LiveProcessTable::forkEvent(pid_t pid, pid_t child) noexcept
+{
+  m_table.insert(child, pid);
+  Object::enqueue_copy(added, child, pid);
+}
+
+void LiveProcessTable::execEvent(pid_t pid) noexcept
+{
+  m_table.invalidate(pid);
+  Object::enqueue_copy(execed, pid);
+}
+
+void LiveProcessTable::exitEvent(pid_t pid, posix::error_t) noexcept
+{
+  if(m_table.erase(pid))
+    Object::enqueue_copy(removed, pid);
+}
@@ -0,0 +1,102 @@
+#ifndef PROCESSTABLE_H
+#define PROCESSTABLE_H
+
+// STL
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// PUT
+#include <put/object.h>
+#include <put/cxxutils/posix_helpers.h>
+#include <put/specialized/procstat.h>
+#include <put/specialized/processevent.h>
+#include <put/specialized/timerevent.h>
+
+// snapshot of every process stored as columns (one vector per field)
+// rows are ordered by pid and row i of every column describes the same process
+class ProcessTable
+{
+public:
+  typedef uint32_t name_id_t; // index of an interned name
+
+  bool refresh(void) noexcept; // rebuilds the table in one sweep over every process
+  bool update(pid_t pid) noexcept; // rereads one process (its row is removed if it has exited)
+
+  // deltas (rows are marked stale until update() reads their stats)
+  void insert(pid_t pid, pid_t parent) noexcept; // forked process inherits the parent's name
+  void invalidate(pid_t pid) noexcept; // process called exec*()
+  bool erase(pid_t pid) noexcept; // process exited
+
+  posix::size_t size(void) const noexcept { return m_pids.size(); }
+  posix::ssize_t indexOf(pid_t pid) const noexcept; // row of pid (-1 if absent)
+
+  const std::vector<pid_t>& pids(void) const noexcept { return m_pids; }
+  const std::vector<pid_t>& parentPids(void) const noexcept { return m_ppids; }
+  const std::vector<ExecutionState>& states(void) const noexcept { return m_states; }
+  const std::vector<uint64_t>& userTimes(void) const noexcept { return m_utimes; } // microseconds
+  const std::vector<uint64_t>& systemTimes(void) const noexcept { return m_stimes; } // microseconds
+  const std::vector<segsz_t>& residentSizes(void) const noexcept { return m_rss; } // pages
+  const std::vector<name_id_t>& names(void) const noexcept { return m_names; }
+  const std::vector<uint8_t>& stale(void) const noexcept { return m_stale; } // non-zero if stats are outdated
+
+  const std::string& name(name_id_t id) const noexcept { return m_name_pool[id]; } // ids stay valid across refreshes
+
+private:
+  void append(const process_sample_t& sample) noexcept;
+  void assign(posix::size_t row, const process_sample_t& sample) noexcept;
+  posix::size_t insertRow(pid_t pid) noexcept;
+  void eraseRow(posix::size_t row) noexcept;
+  name_id_t intern(const char* name) noexcept;
+
+  std::vector<pid_t> m_pids;
+  std::vector<pid_t> m_ppids;
+  std::vector<ExecutionState> m_states;
+  std::vector<uint64_t> m_utimes;
+  std::vector<uint64_t> m_stimes;
+  std::vector<segsz_t> m_rss;
+  std::vector<name_id_t> m_names;
+  std::vector<uint8_t> m_stale;
+
+  std::vector<std::string> m_name_pool;
+  std::unordered_map<std::string, name_id_t> m_name_ids;
+};
+
+// process table kept current by applying process events as deltas
+// stats are only reread for processes passed to sample()
+// when events are unavailable or have been dropped every process is rescanned
+class LiveProcessTable : public Object
+{
+public:
+  enum : milliseconds_t
+  {
+    RescanInterval = 1000, // only used when process events are unavailable
+  };
+
+  LiveProcessTable(milliseconds_t rescan_interval = RescanInterval) noexcept;
+
+  const ProcessTable& table(void) const noexcept { return m_table; }
+  bool isLive(void) const noexcept { return m_events.isActive(); } // false if relying on rescans
+
+  bool sample(pid_t pid) noexcept { return m_table.update(pid); } // rereads the stats of a process
+  bool rescan(void) noexcept; // rereads every process and reports the differences
+
+  signal<pid_t, pid_t> added; // process (and its parent) appeared
+  signal<pid_t> execed; // process called exec*()
+  signal<pid_t> removed; // process exited
+
+private:
+  void forkEvent(pid_t pid, pid_t child) noexcept;
+  void execEvent(pid_t pid) noexcept;
+  void exitEvent(pid_t pid, posix::error_t) noexcept;
+  void killEvent(pid_t pid, posix::Signal::EId) noexcept { exitEvent(pid, posix::success_response); }
+  void overflowEvent(pid_t) noexcept { rescan(); }
+  void rescanEvent(void) noexcept { rescan(); }
+
+  ProcessTable m_table;
+  ProcessEvent m_events;
+  TimerEvent m_rescan;
+  std::vector<pid_t> m_previous; // pids before a rescan
+};
+
+#endif // PROCESSTABLE_H
@@ -311,197 +311,166 @@ bool proc_exe_symlink(pid_t pid, const char* subfile, process_state_t& data) noe
 # if defined(__linux__) /* Linux    */
 
 // POSIX
-#  include <inttypes.h> // for fscanf macros
+#  include <inttypes.h> // for sscanf macros
+#  include <fcntl.h>
 
-bool proc_stat_decoder(posix::FILE* file, process_state_t& data) noexcept
-{
-  struct //procinfo_t
-  {
-//    pid_t         pid;                      // The process id.
-    char          name[PATH_MAX];           // process name
-    char          state;                    // R is running, S is sleeping, D is sleeping in an uninterruptible wait, Z is zombie, T is traced or stopped
-//    pid_t         ppid;                     // The pid of the parent.
-//    pid_t         pgrp;                     // The pgrp of the process.
-//    pid_t         session;                  // The session id of the process.
-//    int           tty;                      // The tty the process uses
-    int           tpgid;                    // (too long)
-    unsigned int  flags;                    // The flags of the process.
-    unsigned int  minflt;                   // The number of minor faults
-    unsigned int  cminflt;                  // The number of minor faults with childs
-    unsigned int  majflt;                   // The number of major faults
-    unsigned int  cmajflt;                  // The number of major faults with childs
-    int           utime;                    // user mode jiffies
-    int           stime;                    // kernel mode jiffies
-    int           cutime;                   // user mode jiffies with childs
-    int           cstime;                   // kernel mode jiffies with childs
-    int           priority;                 // the standard nice value, plus fifteen
-    int           nice;                     //
-    int           num_threads;              //
-    unsigned int  itrealvalue;              // The time before the next SIGALRM is sent to the process
-    int           starttime;                // Time the process started after system boot
-
-    unsigned int  vsize;                    // Virtual memory size
-    unsigned int  rss;                      // Resident Set Size
-    unsigned int  rlim;                     // Current limit in bytes on the rss
-
-    unsigned int  startcode;                // The address above which program text can run
-    unsigned int  endcode;                  // The address below which program text can run
-    unsigned int  startstack;               // The address of the start of the stack
-    unsigned int  kstkesp;                  // The current value of ESP
-    unsigned int  kstkeip;                  // The current value of EIP
-    int           signal;                   // The bitmap of pending signals
-    int           blocked;                  // The bitmap of blocked signals
-    int           sigignore;                // The bitmap of ignored signals
-    int           sigcatch;                 // The bitmap of catched signals
-    unsigned int  wchan;                    // This is the "channel" in which the process is waiting. It is the address of a location in the kernel where the process is sleeping. The corresponding symbolic name can be found in /proc/[pid]/wchan.
-    unsigned int  nswap;                    // Number of pages swapped (not maintained)
-    unsigned int  cnswap;                   // Cumulative nswap for child processes (not maintained).
-    int           exit_signal;              // Signal to be sent to parent when we die.
-    int           processor;                // CPU number last executed on.
-    unsigned int  rt_priority;              // Real-time scheduling priority, a number in the range 1 to 99 for processes scheduled under a real-time policy, or 0, for non-real-time processes (see sched_setscheduler(2)).
-    unsigned int  policy;                   // Scheduling policy (see sched_setscheduler(2)). Decode using the SCHED_* constants in linux/sched.h.
-  } process;
-
-  int scancount =
-    posix::fscanf(file,
-                "%" SCNd32 " " // pid
-                "%s " // comm
-                "%c " // state
-                "%" SCNd32 " " // ppid
-                "%" SCNd32 " " // pgrp
-                "%" SCNd32 " " // session
-                "%" SCNd64 " " // tty_nr
-                "%" SCNd32 " " // tpgid
-                "%" SCNu32 " " // flags
-                "%" SCNd32 " " // minflt
-                "%" SCNu32 " " // cminflt
-                "%" SCNu32 " " // majflt
-                "%" SCNu32 " " // cmajflt
-                "%" SCNu32 " " // utime
-                "%" SCNu32 " " // stime
-                "%" SCNd32 " " // cutime
-                "%" SCNd32 " " // cstime
-                "%" SCNd32 " " // priority
-                "%" SCNd8  " " // nice
-                "%" SCNu32 " " // num_threads
-                "%" SCNu32 " " // itrealvalue
-                "%" SCNu32 " " // starttime
-                "%" SCNu32 " " // vsize
-                "%" SCNd32 " " // rss
-                "%" SCNu32 " " // rsslim
-                "%" SCNu32 " " // startcode
-                "%" SCNu32 " " // endcode
-                "%" SCNu32 " " // startstack
-                "%" SCNu32 " " // kstkesp
-                "%" SCNu32 " " // kstkeip
-                "%" SCNu32 " " // signal
-                "%" SCNu32 " " // blocked
-                "%" SCNu32 " " // sigignore
-                "%" SCNu32 " " // sigcatch
-                "%" SCNu32 " " // wchan
-                "%" SCNu32 " " // nswap
-                "%" SCNu32 " " // cnswap
-              #if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,1,22)
-                "%" SCNd32 " " // exit_signal
-              # if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,2,8)
-                "%" SCNd32 " " // processor
-              #  if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,5,19)
-                "%" SCNu32 " " // rt_priority
-                "%" SCNu32 " " // policy
-              #  endif
-              # endif
-              #endif
-                , &data.process_id
-                , process.name
-                , &process.state
-                , &data.parent_process_id
-                , &data.process_group_id
-                , &data.session_id
-                , &data.tty_device
-                , &process.tpgid
-                , &process.flags
-                , &process.minflt
-                , &process.cminflt
-                , &process.majflt
-                , &process.cmajflt
-                , &process.utime
-                , &process.stime
-                , &process.cutime
-                , &process.cstime
-                , &data.priority_value
-                , &data.nice_value
-                , &process.num_threads
-                , &process.itrealvalue
-                , &process.starttime
-                , &process.vsize
-                , &process.rss
-                , &process.rlim
-                , &process.startcode
-                , &process.endcode
-                , &process.startstack
-                , &process.kstkesp
-                , &process.kstkeip
-                , &process.signal
-                , &process.blocked
-                , &process.sigignore
-                , &process.sigcatch
-                , &process.wchan
-                , &process.nswap
-                , &process.cnswap
-              #if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,1,22)
-                , &process.exit_signal
-              # if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,2,8)
-                , &process.processor
-              #  if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,5,19)
-                , &process.rt_priority
-                , &process.policy
-              #  endif
-              # endif
-              #endif
-                );
-
-  long int ticks = sysconf(_SC_CLK_TCK);
-  data.start_time.tv_sec  = process.starttime / ticks;
-  data.user_time.tv_sec   = process.utime / ticks;
-  data.system_time.tv_sec = process.stime / ticks;
-  //data.name               = process.name;
-  //data.priority_value // TODO: fixup based on kernel version
-
-  // TODO: add better memory info
-  data.memory_size =
-  {
-    segsz_t(process.rss),
-    segsz_t(process.vsize),
-    -1,-1,-1,
-    sysconf(_SC_PAGESIZE)
-  };
+static const long clock_ticks = sysconf(_SC_CLK_TCK);
+static const long page_size = sysconf(_SC_PAGESIZE);
 
-  switch(process.state)
+static inline ExecutionState proc_state(char code) noexcept
+{
+  switch(code)
   {
-    case 'R': data.state = Running; break; // Running
-    case 'S': data.state = WaitingInterruptable; break; // Sleeping in an interruptible wait
-    case 'D': data.state = WaitingUninterruptable; break; // Waiting in uninterruptible disk sleep
-    case 'Z': data.state = Zombie; break; // Zombie
-    case 'T': data.state = Stopped; break; // Stopped (on a signal) or (before Linux 2.6.33) trace stopped
+    case 'R': return Running; // Running
+    case 'S': return WaitingInterruptable; // Sleeping in an interruptible wait
+    case 'D': return WaitingUninterruptable; // Waiting in uninterruptible disk sleep
+    case 'Z': return Zombie; // Zombie
+    case 'T': return Stopped; // Stopped (on a signal) or (before Linux 2.6.33) trace stopped
 #  if KERNEL_VERSION_CODE < KERNEL_VERSION(2,6,0)
-    case 'W': data.state = WaitingUninterruptable; break; // Paging (only before Linux 2.6.0)
+    case 'W': return WaitingUninterruptable; // Paging (only before Linux 2.6.0)
 #  else
-    case 'X': data.state = Zombie; break; // Dead (from Linux 2.6.0 onward)
+    case 'X': return Zombie; // Dead (from Linux 2.6.0 onward)
 #   if KERNEL_VERSION_CODE >= KERNEL_VERSION(2,6,33)
-    case 't': data.state = Stopped; break; // Tracing stop (Linux 2.6.33 onward)
+    case 't': return Stopped; // Tracing stop (Linux 2.6.33 onward)
 #    if KERNEL_VERSION_CODE <= KERNEL_VERSION(3,13,0)
-    case 'x': data.state = Zombie; break; // Dead (Linux 2.6.33 to 3.13 only)
-    case 'K': data.state = WaitingUninterruptable; break; // Wakekill (Linux 2.6.33 to 3.13 only)
-    case 'W': data.state = WaitingInterruptable; break; // Waking (Linux 2.6.33 to 3.13 only)
-    case 'P': data.state = WaitingInterruptable; break; // Parked (Linux 3.9 to 3.13 only)
+    case 'x': return Zombie; // Dead (Linux 2.6.33 to 3.13 only)
+    case 'K': return WaitingUninterruptable; // Wakekill (Linux 2.6.33 to 3.13 only)
+    case 'W': return WaitingInterruptable; // Waking (Linux 2.6.33 to 3.13 only)
+    case 'P': return WaitingInterruptable; // Parked (Linux 3.9 to 3.13 only)
 #    endif
 #   endif
 #  endif
   }
+  return Invalid;
+}
+
+static inline timeval proc_ticks(uint64_t ticks) noexcept
+{
+  timeval value;
+  value.tv_sec  = time_t(ticks / uint64_t(clock_ticks));
+  value.tv_usec = suseconds_t((ticks % uint64_t(clock_ticks)) * 1000000 / uint64_t(clock_ticks));
+  return value;
+}
 
+// decodes a decimal field and steps over the space that follows it
+template<typename T>
+static inline T proc_field(const char*& pos, const char* end) noexcept
+{
+  bool negative = pos != end && *pos == '-';
+  if(negative)
+    ++pos;
+  uint64_t value = 0;
+  for(; pos != end && *pos >= '0' && *pos <= '9'; ++pos)
+    value = value * 10 + uint64_t(*pos - '0');
+  if(pos != end)
+    ++pos;
+  return negative ? T(-int64_t(value)) : T(value);
+}
+
+static inline void proc_skip(const char*& pos, const char* end, int count) noexcept
+{
+  for(; pos != end && count; ++pos)
+    if(*pos == ' ')
+      --count;
+}
+
+// single pass over the contents of /proc/[pid]/stat (see proc(5) for field numbers)
+static bool proc_stat_parse(const char* pos, const char* end, process_sample_t& data) noexcept
+{
+  data.process_id = proc_field<pid_t>(pos, end); // 1
+
+  const char* close = end; // comm may contain spaces and parentheses so it ends at the last ')'
+  do { --close; } while(close > pos && *close != ')');
+  if(*pos != '(' || close <= pos || end - close < 4)
+    return false;
+
+  posix::size_t length = posix::size_t(close - pos - 1);
+  if(length >= process_sample_t::NameLength)
+    length = process_sample_t::NameLength - 1;
+  posix::memcpy(data.name, pos + 1, length); // 2
+  data.name[length] = '\0';
+
+  pos = close + 2;
+  data.state = proc_state(*pos); // 3
+  pos += 2;
+
+  data.parent_process_id = proc_field<pid_t>(pos, end); // 4
+  data.process_group_id  = proc_field<pid_t>(pos, end); // 5
+  data.session_id        = proc_field<pid_t>(pos, end); // 6
+  data.tty_device        = proc_field<dev_t>(pos, end); // 7
+  proc_skip(pos, end, 2); // tpgid, flags
+  data.minor_faults      = proc_field<uint64_t>(pos, end); // 10
+  proc_skip(pos, end, 1); // cminflt
+  data.major_faults      = proc_field<uint64_t>(pos, end); // 12
+  proc_skip(pos, end, 1); // cmajflt
+  data.user_time         = proc_ticks(proc_field<uint64_t>(pos, end)); // 14
+  data.system_time       = proc_ticks(proc_field<uint64_t>(pos, end)); // 15
+  proc_skip(pos, end, 2); // cutime, cstime
+  data.priority_value    = proc_field<int>(pos, end); // 18
+  data.nice_value        = proc_field<int8_t>(pos, end); // 19
+  data.thread_count      = proc_field<int32_t>(pos, end); // 20
+  proc_skip(pos, end, 1); // itrealvalue
+  data.start_time        = proc_ticks(proc_field<uint64_t>(pos, end)); // 22 (since boot)
+
+  uint64_t vsize         = proc_field<uint64_t>(pos, end); // 23 (bytes)
+  uint64_t rss           = proc_field<uint64_t>(pos, end); // 24 (pages)
+  data.memory_size =
+  {
+    segsz_t(rss),
+    segsz_t(vsize / uint64_t(page_size)),
+    -1,-1,-1,
+    page_size
+  };
+
+  proc_skip(pos, end, 14); // rsslim to exit_signal
+  data.processor = pos == end ? -1 : proc_field<int32_t>(pos, end); // 39 (Linux 2.2.8+)
   return true;
 }
 
+procstat_handle_t::procstat_handle_t(pid_t pid) noexcept
+  : m_pid(0), m_fd(posix::invalid_descriptor)
+{
+  if(pid)
+    open(pid);
+}
+
+procstat_handle_t::~procstat_handle_t(void) noexcept
+  { close(); }
+
+bool procstat_handle_t::open(pid_t pid) noexcept
+{
+  close();
+  if(procfs_path == nullptr) // safety check
+    return false;
+
+  char filename[PATH_MAX] = { 0 };
+  posix::snprintf(filename, PATH_MAX, "%s/%d/stat", procfs_path, pid);
+  m_fd = posix::open(filename, O_RDONLY | O_CLOEXEC);
+  if(m_fd == posix::invalid_descriptor)
+    return false;
+  m_pid = pid;
+  return true;
+}
+
+void procstat_handle_t::close(void) noexcept
+{
+  if(m_fd != posix::invalid_descriptor)
+    posix::close(m_fd);
+  m_fd = posix::invalid_descriptor;
+  m_pid = 0;
+}
+
+bool procstat_handle_t::read(process_sample_t& data) noexcept
+{
+  if(m_fd == posix::invalid_descriptor) // open() failed (errno is still ENOENT if the process doesn't exist)
+    return false;
+
+  char buffer[1024]; // comm is at most 64 bytes so every field fits
+  posix::ssize_t length = posix::pread(m_fd, buffer, sizeof(buffer), 0); // reading from the start rereads the file
+  return length > 0 && // fails with ESRCH once the process has exited
+         proc_stat_parse(buffer, buffer + length, data);
+}
+
 bool proc_status_decoder(posix::FILE* file, process_state_t& data) noexcept
 {
   char* line = static_cast<char*>(posix::malloc(PATH_MAX));
@@ -511,12 +480,6 @@ bool proc_status_decoder(posix::FILE* file, process_state_t& data) noexcept
 
   size_t line_sz = 0;
 
-  char name[PATH_MAX] = { 0 };
-  while(posix::getline(&line, &line_sz, file) > 0 &&
-        posix::memcmp(line, "Name:\t", sizeof("Name:\t") - 1));
-  posix::sscanf(line, "Name:\t%s\n", name);
-  data.name = name;
-
   while(posix::getline(&line, &line_sz, file) > 0 &&
         posix::memcmp(line, "Uid:\t", sizeof("Uid:\t") - 1));
   posix::sscanf(line, "Uid:\t%" SCNi32 "\t%" SCNi32 "\t",
@@ -824,8 +787,26 @@ bool real_procstat(pid_t pid, process_state_t& data) noexcept
     return false;
 
 # if defined(__linux__) // Linux
-  if(!proc_decode(pid, "stat"    , proc_stat_decoder   , data) ||
-     !proc_decode(pid, "status"  , proc_status_decoder , data) ||
+  process_sample_t sample;
+  procstat_handle_t stat_file(pid);
+  if(!stat_file.read(sample))
+    return false;
+
+  data.name              = sample.name; // may contain spaces
+  data.state             = sample.state;
+  data.process_id        = sample.process_id;
+  data.parent_process_id = sample.parent_process_id;
+  data.process_group_id  = sample.process_group_id;
+  data.session_id        = sample.session_id;
+  data.tty_device        = sample.tty_device;
+  data.priority_value    = sample.priority_value;
+  data.nice_value        = sample.nice_value;
+  data.start_time        = sample.start_time;
+  data.user_time         = sample.user_time;
+  data.system_time       = sample.system_time;
+  data.memory_size       = sample.memory_size;
+
+  if(!proc_decode(pid, "status"  , proc_status_decoder , data) ||
      !proc_decode(pid, "cmdline" , proc_cmdline_decoder, data))
     return false;
 
@@ -869,3 +850,57 @@ bool procstat(pid_t pid, process_state_t& data) noexcept
 # error Unsupported platform! >:(
 #endif
 
+#if !defined(__linux__) // samples are decoded from the full process state
+procstat_handle_t::procstat_handle_t(pid_t pid) noexcept
+  : m_pid(0), m_fd(posix::invalid_descriptor)
+{
+  if(pid)
+    open(pid);
+}
+
+procstat_handle_t::~procstat_handle_t(void) noexcept
+  { close(); }
+
+bool procstat_handle_t::open(pid_t pid) noexcept
+{
+  m_pid = pid;
+  return true;
+}
+
+void procstat_handle_t::close(void) noexcept
+  { m_pid = 0; }
+
+bool procstat_handle_t::read(process_sample_t& data) noexcept
+{
+  process_state_t state;
+  if(!procstat(m_pid, state))
+    return false;
+
+  posix::strncpy(data.name, state.name.c_str(), process_sample_t::NameLength - 1);
+  data.name[process_sample_t::NameLength - 1] = '\0';
+  data.state             = state.state;
+  data.process_id        = state.process_id;
+  data.parent_process_id = state.parent_process_id;
+  data.process_group_id  = state.process_group_id;
+  data.session_id        = state.session_id;
+  data.tty_device        = state.tty_device;
+  data.priority_value    = state.priority_value;
+  data.nice_value        = state.nice_value;
+  data.thread_count      = -1;
+  data.processor         = -1;
+  data.minor_faults      = 0;
+  data.major_faults      = 0;
+  data.start_time        = state.start_time;
+  data.user_time         = state.user_time;
+  data.system_time       = state.system_time;
+  data.memory_size       = state.memory_size;
+  return true;
+}
+#endif
+
+bool procstat(pid_t pid, process_sample_t& data) noexcept
+{
+  procstat_handle_t handle(pid);
+  return handle.read(data);
+}
+
@@ -68,6 +68,56 @@ struct process_state_t
   } memory_size;
 };
 
+// fixed size subset of process_state_t (no allocation) for sampling processes repeatedly
+struct process_sample_t
+{
+  enum : posix::size_t { NameLength = 16 }; // TASK_COMM_LEN
+
+  char name[NameLength];    // process name (truncated)
+  ExecutionState state;     // process execution state
+  pid_t process_id;         // process id
+  pid_t parent_process_id;  // process id of the parent process
+  pid_t process_group_id;   // process group id
+  pid_t session_id;         // session id
+
+  dev_t tty_device;         // device id of the tty device the process is running on
+
+  int priority_value;
+  int8_t nice_value;        // nice value
+  int32_t thread_count;     // number of threads
+  int32_t processor;        // CPU last executed on (-1 if unknown)
+
+  uint64_t minor_faults;    // page faults without disk access
+  uint64_t major_faults;    // page faults with disk access
+
+  timeval start_time;       // process start time
+  timeval user_time;        // process user time spent
+  timeval system_time;      // process system time spent
+
+  process_state_t::memory_sizes_t memory_size;
+};
+
+// keeps the process's stat file open so it can be sampled without path lookups
+struct procstat_handle_t
+{
+  procstat_handle_t(pid_t pid = 0) noexcept;
+  ~procstat_handle_t(void) noexcept;
+  procstat_handle_t(const procstat_handle_t&) = delete;
+  procstat_handle_t& operator =(const procstat_handle_t&) = delete;
+
+  bool open(pid_t pid) noexcept;
+  void close(void) noexcept;
+  bool read(process_sample_t& data) noexcept; // fails once the process has exited
+
+  pid_t pid(void) const noexcept { return m_pid; }
+  bool isOpen(void) const noexcept { return m_fd != posix::invalid_descriptor; }
+
+private:
+  pid_t m_pid;
+  posix::fd_t m_fd;
+};
+
 bool procstat(pid_t pid, process_state_t& data) noexcept;
+bool procstat(pid_t pid, process_sample_t& data) noexcept;
 
 #endif // PROCSTAT_H
@@ -8,53 +8,266 @@
 # pragma message("Forcing use of POSIX timers.")
 # define FALLBACK_ON_POSIX_TIMERS
 
-#elif defined(__linux__) && KERNEL_VERSION_CODE >= KERNEL_VERSION(2,6,25) /* Linux 2.6.25+ */
+#elif defined(TIMER_WHEEL) /* Linux 2.6.25+ */
 
 // Linux
 # include <sys/timerfd.h>
+# include <time.h>
+# include <assert.h>
 
-// timer notification (Linux)
-TimerEvent::TimerEvent(void) noexcept
+// PUT
+# include <put/cxxutils/vterm.h>
+
+enum : uint16_t
+{
+  TickShift = 17, // ticks are 2^17 ns (~131 microseconds)
+  SlotBits = 6,
+  Slots = 1 << SlotBits, // slots per level (one bit each in a uint64_t)
+  Levels = 7, // up to 2^42 ticks (~18 years)
+  Detached = 0xFFFE, // in a temporary list
+  NotQueued = 0xFFFF,
+};
+
+static uint64_t monotonic_time(void) noexcept
 {
-  m_fd = ::timerfd_create(CLOCK_MONOTONIC, 0);
-  if(m_fd != posix::invalid_descriptor)
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+struct TimerEvent::platform_dependant // hierarchical timer wheel multiplexed onto one timerfd (Linux)
+{
+  posix::fd_t fd;
+  uint64_t now; // current tick (every queued timer is due at or after it)
+  uint64_t armed; // time the timerfd is set to (0 if disarmed)
+  uint64_t occupied[Levels]; // slots containing timers
+  TimerEvent* slots[Levels][Slots];
+  TimerEvent* expiring; // timers that are due
+
+  platform_dependant(void) noexcept
+    : now(monotonic_time() >> TickShift), armed(0), expiring(nullptr)
   {
-    posix::fcntl(m_fd, F_SETFD, FD_CLOEXEC); // close on exec*()
-    posix::donotblock(m_fd); // don't block
+    posix::memset(occupied, 0, sizeof(occupied));
+    posix::memset(slots, 0, sizeof(slots));
+    fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    flaw(fd == posix::invalid_descriptor,
+         terminal::warning,,,
+         "Unable to create timerfd for TimerEvent: %s", posix::strerror(errno))
+
+    EventBackend::add(fd, EventBackend::SimplePollReadFlags, // every timer of this event loop shares one FD
+                      [this](posix::fd_t, native_flags_t) noexcept { expire(); });
   }
 
-  EventBackend::add(m_fd, EventBackend::SimplePollReadFlags, // connect communications pipe to a lambda function
-                    [this](posix::fd_t lambda_fd, native_flags_t) noexcept
+  ~platform_dependant(void) noexcept
+  {
+    for(uint16_t level = 0; level < Levels; ++level) // detach remaining timers
+      for(uint16_t index = 0; index < Slots; ++index)
+        for(TimerEvent* timer = slots[level][index]; timer != nullptr; timer = timer->m_next)
+          timer->m_wheel = nullptr;
+    for(TimerEvent* timer = expiring; timer != nullptr; timer = timer->m_next)
+      timer->m_wheel = nullptr;
+
+    if(fd != posix::invalid_descriptor)
+    {
+      EventBackend::remove(fd, EventBackend::SimplePollReadFlags);
+      posix::close(fd);
+    }
+  }
+
+  static void link(TimerEvent*& head, TimerEvent* timer, uint16_t slot) noexcept
+  {
+    timer->m_next = head;
+    if(head != nullptr)
+      head->m_prev = &timer->m_next;
+    timer->m_prev = &head;
+    timer->m_slot = slot;
+    head = timer;
+  }
+
+  void unlink(TimerEvent* timer) noexcept // O(1)
+  {
+    *timer->m_prev = timer->m_next;
+    if(timer->m_next != nullptr)
+      timer->m_next->m_prev = timer->m_prev;
+
+    if(timer->m_slot < Detached) // if it was in a slot
+    {
+      uint16_t level = timer->m_slot / Slots;
+      uint16_t index = timer->m_slot % Slots;
+      if(slots[level][index] == nullptr) // slot is now empty
+        occupied[level] &= ~(uint64_t(1) << index);
+    }
+    timer->m_slot = NotQueued;
+    timer->m_wheel = nullptr;
+  }
+
+  void insert(TimerEvent* timer) noexcept // O(1)
+  {
+    uint64_t tick = timer->m_deadline >> TickShift;
+    if(tick < now)
+      tick = now;
+
+    uint16_t level = tick == now ? 0 : uint16_t((63 - __builtin_clzll(tick ^ now)) / SlotBits); // highest digit that differs from now
+    if(level >= Levels)
+      level = Levels - 1;
+    uint16_t index = (tick >> (level * SlotBits)) % Slots;
+
+    link(slots[level][index], timer, uint16_t(level * Slots + index));
+    occupied[level] |= uint64_t(1) << index;
+    timer->m_wheel = this;
+  }
+
+  // move every due timer to the expiring list and cascade timers from slots that have been reached
+  void advance(uint64_t time) noexcept
+  {
+    uint64_t target = time >> TickShift;
+    TimerEvent* moving = nullptr;
+
+    for(uint16_t level = 0; level < Levels; ++level)
+    {
+      uint16_t shift = level * SlotBits;
+      uint64_t mask = ~uint64_t(0); // higher digits changed so every slot in this level has been reached
+      if(target >> (shift + SlotBits) == now >> (shift + SlotBits))
+      {
+        uint64_t first = (now    >> shift) % Slots;
+        uint64_t last  = (target >> shift) % Slots;
+        mask = (last + 1 == Slots ? ~uint64_t(0) : (uint64_t(1) << (last + 1)) - 1) & ~((uint64_t(1) << first) - 1);
+      }
+
+      for(uint64_t bits = occupied[level] & mask; bits; bits &= bits - 1) // only visit slots containing timers
+      {
+        uint16_t index = uint16_t(__builtin_ctzll(bits));
+        while(slots[level][index] != nullptr)
+        {
+          TimerEvent* timer = slots[level][index];
+          unlink(timer);
+          link(moving, timer, Detached);
+        }
+      }
+    }
+
+    now = target;
+    while(moving != nullptr)
+    {
+      TimerEvent* timer = moving;
+      unlink(timer);
+      if(timer->m_deadline <= time)
+      {
+        link(expiring, timer, Detached);
+        timer->m_wheel = this;
+      }
+      else
+        insert(timer); // lower level
+    }
+  }
+
+  uint64_t next(void) const noexcept // time when the wheel needs processing (0 if empty)
+  {
+    if(expiring != nullptr)
+      return 1; // already due
+
+    if(occupied[0]) // exact deadline of the earliest timer
+    {
+      uint64_t deadline = UINT64_MAX;
+      for(TimerEvent* timer = slots[0][__builtin_ctzll(occupied[0])]; timer != nullptr; timer = timer->m_next)
+        if(timer->m_deadline < deadline)
+          deadline = timer->m_deadline;
+      return deadline;
+    }
+
+    for(uint16_t level = 1; level < Levels; ++level)
+      if(occupied[level]) // start of the earliest slot (it will cascade)
+      {
+        uint16_t shift = level * SlotBits;
+        uint64_t tick = (now >> (shift + SlotBits) << (shift + SlotBits)) |
+                        (uint64_t(__builtin_ctzll(occupied[level])) << shift);
+        return tick << TickShift;
+      }
+    return 0;
+  }
+
+  void arm(void) noexcept
+  {
+    uint64_t deadline = next();
+    if(deadline == armed) // avoid redundant system calls
+      return;
+    armed = deadline;
+
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = time_t(deadline / 1000000000);
+    spec.it_value.tv_nsec = long(deadline % 1000000000);
+    ::timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL); // zero disarms
+  }
+
+  void expire(void) noexcept
   {
     uint64_t discard;
-    while(posix::read(lambda_fd, &discard, sizeof(discard)) != posix::error_response);
-    Object::enqueue(expired);
-  });
+    posix::read(fd, &discard, sizeof(discard));
+    armed = 0;
+
+    uint64_t time = monotonic_time();
+    advance(time);
+    while(expiring != nullptr) // every timer due in this tick
+    {
+      TimerEvent* timer = expiring;
+      unlink(timer);
+      if(timer->m_interval)
+      {
+        timer->m_deadline += timer->m_interval;
+        if(timer->m_deadline <= time) // skip missed intervals
+          timer->m_deadline = time + timer->m_interval;
+        insert(timer);
+      }
+      Object::enqueue(timer->expired); // slots may start/stop timers
+    }
+    arm();
+  }
+};
+
+TimerEvent::platform_dependant& TimerEvent::wheel(void) noexcept
+{
+  static thread_local platform_dependant local; // constructed on first use by each event loop thread
+  return local;
 }
 
+TimerEvent::TimerEvent(void) noexcept
+  : m_wheel(nullptr), m_next(nullptr), m_prev(nullptr),
+    m_deadline(0), m_interval(0), m_slot(NotQueued) { }
+
 TimerEvent::~TimerEvent(void) noexcept
 {
-  if(m_fd != posix::invalid_descriptor)
-    posix::close(m_fd);
+  stop();
 }
 
 bool TimerEvent::start(milliseconds_t delay, bool repeat) noexcept
 {
-  struct itimerspec interval_spec;
-  interval_spec.it_value.tv_sec = delay / 1000;
-  interval_spec.it_value.tv_nsec = (delay % 1000) * 1000000;
+  platform_dependant& local = wheel();
+  if(local.fd == posix::invalid_descriptor)
+    return false;
 
-  if(repeat)
-    posix::memcpy(&interval_spec.it_interval, &interval_spec.it_value, sizeof(struct timespec));
-  else
-    posix::memset(&interval_spec.it_interval, 0, sizeof(struct timespec));
+  assert(m_wheel == nullptr || m_wheel == &local); // wheels are not synchronized
+  if(m_wheel != nullptr)
+    m_wheel->unlink(this);
 
-  return ::timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &interval_spec, NULL) == posix::success_response;
+  uint64_t time = monotonic_time();
+  if(local.expiring == nullptr && local.next() == 0) // empty wheel: catch up without cascading
+    local.now = time >> TickShift;
+
+  m_interval = repeat ? uint64_t(delay) * 1000000 : 0;
+  m_deadline = time + uint64_t(delay) * 1000000;
+  local.insert(this);
+  local.arm();
+  return true;
 }
 
 bool TimerEvent::stop(void) noexcept
 {
-  return start(0, true);
+  if(m_wheel != nullptr) // timerfd is left armed (the wheel ignores an early expiration)
+  {
+    assert(m_wheel == &wheel()); // wheels are not synchronized
+    m_wheel->unlink(this);
+  }
+  return true;
 }
 
 #elif defined(__darwin__)     /* Darwin 7+     */ || \
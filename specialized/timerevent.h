@@ -3,6 +3,11 @@
 
 // PUT
 #include <put/object.h>
+#include <put/specialized/osdetect.h>
+
+#if !defined(FORCE_POSIX_TIMERS) && defined(__linux__) && KERNEL_VERSION_CODE >= KERNEL_VERSION(2,6,25) /* Linux 2.6.25+ */
+# define TIMER_WHEEL // every timer of an event loop thread shares one timerfd
+#endif
 
 template<typename T> constexpr milliseconds_t seconds(T count) { return 1000 * count; }
 
@@ -17,9 +22,19 @@ public:
 
   signal<> expired;
 private:
-  posix::fd_t m_fd;
   struct platform_dependant;
+#if defined(TIMER_WHEEL) // start(), stop() and the destructor must be called from the thread of the wheel the timer is queued in
+  static platform_dependant& wheel(void) noexcept; // wheel of the calling thread's event loop
+  platform_dependant* m_wheel; // wheel this timer is queued in
+  TimerEvent* m_next;
+  TimerEvent** m_prev;
+  uint64_t m_deadline; // nanoseconds (CLOCK_MONOTONIC)
+  uint64_t m_interval; // nanoseconds (0 if not repeating)
+  uint16_t m_slot; // level and slot in the wheel
+#else
+  posix::fd_t m_fd;
   static struct platform_dependant s_platform;
+#endif
 };
 
 #endif // TIMEREVENT_H
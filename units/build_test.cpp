@@ -1,4 +1,5 @@
 #include <put/socket.h>
+#include <put/rpc.h>
 #include <childprocess.h>
 #include <put/application.h>
 #include <put/object.h>
@@ -7,6 +8,7 @@
 #include <put/specialized/eventbackend.h>
 #include <put/specialized/mutex.h>
 #include <put/specialized/proclist.h>
+#include <put/specialized/processtable.h>
 #include <put/specialized/peercred.h>
 #include <put/specialized/fstable.h>
 #include <put/specialized/module.h>
@@ -17,10 +19,12 @@
 #include <put/specialized/processevent.h>
 #include <put/cxxutils/pipedspawn.h>
 #include <put/cxxutils/vfifo.h>
+#include <put/cxxutils/vschema.h>
 #include <put/cxxutils/pipedfork.h>
 #include <put/cxxutils/cstringarray.h>
 #include <put/cxxutils/configmanip.h>
 #include <put/cxxutils/misc_helpers.h>
+#include <put/cxxutils/mpscqueue.h>
 #include <put/cxxutils/posix_helpers.h>
 #include <put/cxxutils/socket_helpers.h>
 #include <put/cxxutils/error_helpers.h>
@@ -30,6 +34,8 @@
 #include <put/cxxutils/nullable.h>
 #include <put/cxxutils/hashing.h>
 #include <put/cxxutils/stringtoken.h>
+#include <put/cxxutils/task.h>
+#include <put/cxxutils/smallvector.h>
 
 int main(int, char* [])
 {
@@ -0,0 +1,204 @@
+// POSIX
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// STL
+#include <atomic>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/specialized/pollevent.h>
+#include <put/application.h>
+
+enum : posix::size_t {
+  Total = 16 * 1024 * 1024, // bytes sent for each mode
+  Burst = 32 * 1024, // bytes written before the event loop runs
+  Chunk = 4 * 1024, // bytes read with each read()
+};
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+struct Reader : PollEvent
+{
+  Reader(posix::fd_t fd, Flags_t mode) noexcept
+    : PollEvent(fd, Readable | mode), bytes(0)
+  {
+    Object::connect(activated,
+                    [this](posix::fd_t lambda_fd, Flags_t) noexcept
+                    {
+                      char buffer[Chunk];
+                      posix::ssize_t count;
+                      do // edge triggered FDs must be read until EAGAIN
+                      {
+                        count = posix::read(lambda_fd, buffer, Chunk);
+                        if(count > 0)
+                          bytes += posix::size_t(count);
+                      } while(m_flags.EdgeTriggered && count > 0);
+
+                      if(m_flags.OneShot)
+                        rearm();
+                    }, DirectConnection);
+  }
+
+  posix::size_t bytes;
+};
+
+static bool bench(const char* name, PollEvent::Flags_t mode) noexcept
+{
+  posix::fd_t fds[2];
+  flaw(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == posix::error_response,
+       terminal::critical,,false,
+       "socketpair() failed: %s", posix::strerror(errno))
+  posix::donotblock(fds[0]);
+
+  static char data[Burst];
+  uint64_t wakeups = 0;
+  uint64_t elapsed = now();
+  posix::size_t received = 0;
+  {
+    Reader reader(fds[0], mode);
+    for(posix::size_t sent = 0; sent < Total; sent += Burst)
+    {
+      flaw(posix::write(fds[1], data, Burst) != posix::ssize_t(Burst),
+           terminal::critical,,false,
+           "write() failed: %s", posix::strerror(errno))
+      while(reader.bytes < sent + Burst)
+      {
+        Application::processQueue(); // one epoll_wait() per call
+        ++wakeups;
+      }
+    }
+    received = reader.bytes;
+  }
+  elapsed = now() - elapsed;
+  posix::close(fds[0]);
+  posix::close(fds[1]);
+
+  posix::printf("%-12s %8.1f wakeups/MiB %8.0f bytes/wakeup %8.1f MiB/s\n",
+                name,
+                double(wakeups) * 1024 * 1024 / Total,
+                double(Total) / wakeups,
+                double(Total) / 1024 / 1024 / (double(elapsed) / 1000000000));
+  return received == Total;
+}
+
+// an FD closed before its watch is removed stays registered while a duplicate of it is open
+static bool closed_before_removed(void) noexcept
+{
+  posix::fd_t fds[2];
+  posix::fd_t live[2];
+  flaw(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds ) == posix::error_response ||
+       ::socketpair(AF_UNIX, SOCK_STREAM, 0, live) == posix::error_response,
+       terminal::critical,,false,
+       "socketpair() failed: %s", posix::strerror(errno))
+  posix::fd_t duplicate = ::dup(fds[0]);
+  posix::donotblock(live[0]);
+
+  {
+    Reader closed(fds[0], PollEvent::Invalid);
+    posix::close(fds[0]); // remove() will fail with EBADF
+  }
+
+  Reader reader(live[0], PollEvent::Invalid);
+  for(int i = 0; i < 4; ++i) // free the removed watch then poll the stale registration
+  {
+    flaw(posix::write(fds[1], "x", 1) != 1 ||
+         posix::write(live[1], "x", 1) != 1,
+         terminal::critical,,false,
+         "write() failed: %s", posix::strerror(errno))
+    Application::processQueue();
+  }
+
+  posix::close(duplicate);
+  posix::close(fds[1]);
+  posix::close(live[0]);
+  posix::close(live[1]);
+  return reader.bytes > 0;
+}
+
+// a watch added by another thread must reach an event loop that's already waiting
+static posix::fd_t s_watched = posix::invalid_descriptor;
+static posix::fd_t s_backup = posix::invalid_descriptor;
+static std::atomic_bool s_seen(false);
+
+static void* add_watch(void*) noexcept
+{
+  Application::setAffinity(0); // add to the backend of the waiting event loop
+  ::usleep(100000);
+  EventBackend::add(s_watched, EventBackend::SimplePollReadFlags,
+                    [](posix::fd_t fd, native_flags_t) noexcept
+                    {
+                      char discard;
+                      posix::read(fd, &discard, 1);
+                      s_seen = true;
+                    });
+  for(int i = 0; i < 100 && !s_seen; ++i)
+    ::usleep(10000);
+  if(!s_seen) // wake the event loop so the failure is reported
+    posix::write(s_backup, "x", 1);
+  return nullptr;
+}
+
+static bool cross_thread(void) noexcept
+{
+  posix::fd_t fds[2];
+  posix::fd_t backup[2];
+  flaw(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds   ) == posix::error_response ||
+       ::socketpair(AF_UNIX, SOCK_STREAM, 0, backup) == posix::error_response,
+       terminal::critical,,false,
+       "socketpair() failed: %s", posix::strerror(errno))
+  s_watched = fds[0];
+  s_backup = backup[1];
+
+  posix::size_t woken = 0;
+  {
+    Reader waker(backup[0], PollEvent::Invalid);
+    flaw(posix::write(fds[1], "x", 1) != 1,
+         terminal::critical,,false,
+         "write() failed: %s", posix::strerror(errno))
+
+    pthread_t thread;
+    flaw(::pthread_create(&thread, NULL, add_watch, nullptr) != posix::success_response,
+         terminal::critical,,false,
+         "pthread_create() failed")
+
+    while(!s_seen && !waker.bytes)
+      Application::processQueue();
+    ::pthread_join(thread, nullptr);
+    woken = waker.bytes;
+
+    EventBackend::remove(fds[0], EventBackend::SimplePollReadFlags);
+  }
+  posix::close(fds[0]);
+  posix::close(fds[1]);
+  posix::close(backup[0]);
+  posix::close(backup[1]);
+  return s_seen && !woken;
+}
+
+int main(int, char* [])
+{
+  Application app;
+  flaw(!bench("level", PollEvent::Invalid) ||
+       !bench("edge", PollEvent::EdgeTriggered) ||
+       !bench("oneshot", PollEvent::OneShot) ||
+       !bench("edge+oneshot", PollEvent::Flags_t(PollEvent::EdgeTriggered | PollEvent::OneShot)),
+       terminal::critical,,EXIT_FAILURE,
+       "bytes were lost")
+  flaw(!closed_before_removed(),
+       terminal::critical,,EXIT_FAILURE,
+       "closed FD was not ignored")
+  flaw(!cross_thread(),
+       terminal::critical,,EXIT_FAILURE,
+       "watch added by another thread was not seen")
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
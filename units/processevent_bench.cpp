@@ -0,0 +1,158 @@
+// POSIX
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/specialized/pollevent.h>
+#include <put/specialized/processevent.h>
+#include <put/application.h>
+
+enum : posix::size_t {
+  Storm = 4000, // short-lived processes created for each mode
+  Watched = 4, // processes watched for their exit
+};
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+struct Watcher : Object
+{
+  void killedEvent(pid_t, posix::Signal::EId) noexcept { ++killed; }
+  posix::size_t killed = 0;
+};
+
+// forks Storm processes that nobody watches then writes to the pipe
+static pid_t storm(posix::fd_t done) noexcept
+{
+  pid_t pid = ::fork();
+  if(pid == 0)
+  {
+    for(posix::size_t count = 0; count < Storm; ++count)
+    {
+      pid_t child = ::fork();
+      if(child == 0)
+        ::_exit(EXIT_SUCCESS);
+      ::waitpid(child, nullptr, 0);
+    }
+    posix::write(done, "", 1);
+    ::_exit(EXIT_SUCCESS);
+  }
+  return pid;
+}
+
+static bool bench(const char* name, bool filtered) noexcept
+{
+  posix::fd_t fds[2];
+  flaw(!posix::pipe(fds),
+       terminal::critical,,false,
+       "pipe() failed: %s", posix::strerror(errno))
+
+  pid_t children[Watched];
+  ProcessEvent* events[Watched];
+  Watcher watcher;
+  for(posix::size_t i = 0; i < Watched; ++i)
+  {
+    children[i] = ::fork();
+    if(children[i] == 0)
+    {
+      ::pause();
+      ::_exit(EXIT_SUCCESS);
+    }
+    events[i] = new ProcessEvent(children[i], ProcessEvent::Exit);
+    Object::connect(events[i]->killed, &watcher, &Watcher::killedEvent);
+  }
+
+  // a subscriber for every process needs every event so the filter is detached
+  ProcessEvent* any = filtered ? nullptr : new ProcessEvent(ProcessEvent::AnyProcess, ProcessEvent::Any);
+  bool active = events[0]->isActive() && (filtered || any->isActive());
+
+  uint64_t wakeups = 0;
+  uint64_t elapsed = now();
+  {
+    bool finished = false;
+    PollEvent done(fds[0], PollEvent::Readable);
+    Object::connect(done.activated,
+                    [&finished](posix::fd_t, PollEvent::Flags_t) noexcept { finished = true; },
+                    Object::DirectConnection);
+
+    pid_t pid = storm(fds[1]);
+    while(!finished)
+    {
+      Application::processQueue(); // one epoll_wait() per call
+      ++wakeups;
+    }
+    ::waitpid(pid, nullptr, 0);
+  }
+  elapsed = now() - elapsed;
+
+  // the watched processes must still be reported
+  for(posix::size_t i = 0; i < Watched; ++i)
+    ::kill(children[i], SIGKILL);
+  while(active && watcher.killed < Watched)
+    Application::processQueue();
+
+  for(posix::size_t i = 0; i < Watched; ++i)
+  {
+    ::waitpid(children[i], nullptr, 0);
+    delete events[i];
+  }
+  delete any;
+  posix::close(fds[0]);
+  posix::close(fds[1]);
+
+  posix::printf("%-10s %8llu wakeups %10.0f wakeups/s %8.1f ms\n",
+                name,
+                static_cast<unsigned long long>(wakeups),
+                double(wakeups) / (double(elapsed) / 1000000000),
+                double(elapsed) / 1000000);
+  return watcher.killed == Watched || !active; // nothing can be measured without the connector
+}
+
+// a subscriber for every process only receives the types of event it subscribed to
+static bool wildcard_flags(void) noexcept
+{
+  ProcessEvent* any = new ProcessEvent(ProcessEvent::AnyProcess, ProcessEvent::Exit);
+  if(!any->isActive()) // nothing can be checked without the connector
+  {
+    delete any;
+    return true;
+  }
+
+  pid_t child = posix::invalid_descriptor;
+  bool exited = false;
+  posix::size_t unsubscribed = 0;
+  Object::connect(any->exited, [&child, &exited](pid_t pid, posix::error_t) noexcept { exited |= pid == child; });
+  Object::connect(any->forked, [&unsubscribed](pid_t, pid_t) noexcept { ++unsubscribed; });
+  Object::connect(any->execed, [&unsubscribed](pid_t) noexcept { ++unsubscribed; });
+
+  child = ::fork();
+  if(child == 0)
+    ::_exit(EXIT_SUCCESS);
+  while(!exited)
+    Application::processQueue();
+  ::waitpid(child, nullptr, 0);
+  delete any;
+  return !unsubscribed;
+}
+
+int main(int, char* [])
+{
+  Application app;
+  flaw(!bench("filtered", true) ||
+       !bench("unfiltered", false),
+       terminal::critical,,EXIT_FAILURE,
+       "watched process exits were lost")
+  flaw(!wildcard_flags(),
+       terminal::critical,,EXIT_FAILURE,
+       "events of an unsubscribed type were delivered")
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
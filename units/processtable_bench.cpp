@@ -0,0 +1,208 @@
+// POSIX
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// STL
+#include <algorithm>
+#include <set>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/specialized/processtable.h>
+#include <put/specialized/proclist.h>
+#include <put/application.h>
+
+enum : posix::size_t {
+  Rounds = 100,
+  Attempts = 10, // processes may start or exit between two sweeps
+};
+
+enum : milliseconds_t {
+  Rescan = 50, // only used when process events are unavailable
+};
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+static bool consistent(const ProcessTable& table) noexcept
+{
+  posix::size_t rows = table.size();
+  return std::is_sorted(table.pids().begin(), table.pids().end()) &&
+         std::adjacent_find(table.pids().begin(), table.pids().end()) == table.pids().end() &&
+         table.parentPids().size() == rows &&
+         table.states().size() == rows &&
+         table.userTimes().size() == rows &&
+         table.systemTimes().size() == rows &&
+         table.residentSizes().size() == rows &&
+         table.names().size() == rows &&
+         table.stale().size() == rows;
+}
+
+// refresh() sees the same processes as proclist()
+static bool matches_proclist(void) noexcept
+{
+  ProcessTable table;
+  std::set<pid_t> list;
+  for(posix::size_t attempt = 0; attempt < Attempts; ++attempt)
+  {
+    if(!table.refresh() || !proclist(list))
+      return false;
+    if(consistent(table) &&
+       std::equal(table.pids().begin(), table.pids().end(), list.begin(), list.end()))
+      return table.indexOf(posix::getpid()) != posix::error_response;
+  }
+  return false;
+}
+
+// deltas keep the rows ordered by pid
+static bool deltas_stay_sorted(void) noexcept
+{
+  ProcessTable table;
+  if(!table.refresh() || table.size() < 2)
+    return false;
+
+  pid_t self = posix::getpid();
+  pid_t first = table.pids().front();
+  pid_t last = table.pids().back();
+  pid_t gap = 0; // a pid between two rows
+  for(posix::size_t row = 1; !gap && row < table.size(); ++row)
+    if(table.pids()[row] - table.pids()[row - 1] > 1)
+      gap = table.pids()[row - 1] + 1;
+
+  posix::size_t rows = table.size();
+  table.insert(last + 1000, self); // after every row
+  if(gap)
+    table.insert(gap, self); // between rows
+  if(first > 1)
+    table.insert(first - 1, self); // before every row
+
+  posix::ssize_t row = table.indexOf(last + 1000);
+  if(!consistent(table) ||
+     row == posix::error_response ||
+     !table.stale()[posix::size_t(row)] ||
+     table.parentPids()[posix::size_t(row)] != self ||
+     table.names()[posix::size_t(row)] != table.names()[posix::size_t(table.indexOf(self))]) // inherits the parent's name
+    return false;
+
+  if(table.update(last + 1000) || // doesn't exist: its row is removed
+     table.indexOf(last + 1000) != posix::error_response ||
+     (gap && !table.erase(gap)) ||
+     (first > 1 && !table.erase(first - 1)) ||
+     table.erase(last + 1000) || // already removed
+     table.size() != rows ||
+     !consistent(table))
+    return false;
+
+  table.invalidate(self);
+  row = table.indexOf(self);
+  if(!table.stale()[posix::size_t(row)] ||
+     !table.update(self) ||
+     table.stale()[posix::size_t(row)])
+    return false;
+
+  table.erase(self);
+  return table.update(self) && // reinserted in order
+         table.size() == rows &&
+         consistent(table);
+}
+
+// a forked child is reported as added and then removed once it exits
+static bool live_fork_exit(bool& live) noexcept
+{
+  LiveProcessTable table(Rescan);
+  live = table.isLive();
+
+  pid_t child = posix::invalid_descriptor;
+  bool added = false;
+  bool removed = false;
+  Object::connect(table.added,
+                  [&child, &added](pid_t pid, pid_t parent) noexcept
+                    { added |= pid == child && parent == posix::getpid(); });
+  Object::connect(table.removed,
+                  [&child, &removed](pid_t pid) noexcept
+                    { removed |= pid == child; });
+
+  posix::fd_t gate[2];
+  flaw(!posix::pipe(gate),
+       terminal::critical,,false,
+       "Unable to create a pipe: %s", posix::strerror(errno))
+
+  child = ::fork();
+  if(!child)
+  {
+    char discard;
+    posix::close(gate[1]);
+    posix::read(gate[0], &discard, 1); // wait for the parent to see the fork
+    ::_exit(0);
+  }
+  posix::close(gate[0]);
+  flaw(child == posix::error_response,
+       terminal::critical,,false,
+       "fork() failed: %s", posix::strerror(errno))
+
+  while(!added)
+    Application::processQueue();
+  bool present = table.table().indexOf(child) != posix::error_response;
+
+  posix::close(gate[1]); // the child exits
+  ::waitpid(child, nullptr, 0);
+  while(!removed)
+    Application::processQueue();
+  return present && table.table().indexOf(child) == posix::error_response;
+}
+
+static void bench(void) noexcept
+{
+  ProcessTable table;
+  std::set<pid_t> list;
+  process_sample_t sample;
+
+  uint64_t refresh_time = now();
+  for(posix::size_t round = 0; round < Rounds; ++round)
+    table.refresh();
+  refresh_time = now() - refresh_time;
+
+  uint64_t proclist_time = now();
+  for(posix::size_t round = 0; round < Rounds; ++round)
+  {
+    list.clear();
+    proclist(list);
+    for(pid_t pid : list)
+      procstat(pid, sample);
+  }
+  proclist_time = now() - proclist_time;
+
+  posix::printf("%lu processes: refresh() %7.3f ms, proclist() and procstat() %7.3f ms\n",
+                table.size(),
+                double(refresh_time) / Rounds / 1000000,
+                double(proclist_time) / Rounds / 1000000);
+}
+
+int main(int, char* [])
+{
+  Application app;
+  ::alarm(30); // a missed event fails instead of hanging
+
+  flaw(!matches_proclist(),
+       terminal::critical,,EXIT_FAILURE,
+       "refresh() does not match proclist()")
+  flaw(!deltas_stay_sorted(),
+       terminal::critical,,EXIT_FAILURE,
+       "deltas did not keep the table sorted")
+
+  bool live = false;
+  flaw(!live_fork_exit(live),
+       terminal::critical,,EXIT_FAILURE,
+       "forked process was not added and removed")
+  posix::printf("live process table uses %s\n", live ? "process events" : "rescans");
+
+  bench();
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
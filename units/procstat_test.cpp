@@ -4,6 +4,7 @@
 // POSIX
 #include <assert.h>
 #include <inttypes.h> // for fscanf macros
+#include <time.h>
 
 // STL
 #include <algorithm>
@@ -104,6 +105,51 @@ constexpr bool not_zero(const char* data)
   { return (data[0] != '0' && data[0] != '-') || data[1] != '\0'; }
 
 
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+enum : int { BenchSamples = 20000 };
+
+static void print_rate(const char* name, uint64_t elapsed) noexcept
+{
+  posix::printf("%-14s %8.2f us/sample %10.0f samples/s\n",
+                name,
+                double(elapsed) / 1000 / BenchSamples,
+                double(BenchSamples) * 1000000000 / double(elapsed));
+}
+
+// samples this process repeatedly with each interface
+static bool procstat_bench(void) noexcept
+{
+  pid_t pid = ::getpid();
+  process_state_t state;
+  process_sample_t sample;
+  procstat_handle_t handle(pid);
+  bool ok = handle.isOpen();
+  uint64_t elapsed;
+
+  elapsed = now();
+  for(int i = 0; ok && i < BenchSamples; ++i)
+    ok = procstat(pid, state);
+  print_rate("full state", now() - elapsed);
+
+  elapsed = now();
+  for(int i = 0; ok && i < BenchSamples; ++i)
+    ok = procstat(pid, sample);
+  print_rate("sample", now() - elapsed);
+
+  elapsed = now();
+  for(int i = 0; ok && i < BenchSamples; ++i)
+    ok = handle.read(sample);
+  print_rate("cached handle", now() - elapsed);
+
+  return ok && sample.process_id == pid;
+}
+
 void file_cleanup(void)
 {
   assert(!system("rm -f psoutput sedoutput"));
@@ -186,6 +232,7 @@ int main(int, char* [])
   assert(!system(sed_command));
 
   process_state_t ps_state, procstat_state;
+  process_sample_t procstat_sample;
 
   char* field_buffer = NULL;
   pid_t skip_count = 0;
@@ -370,12 +417,28 @@ int main(int, char* [])
          terminal::critical,system(tmp_buffer1),EXIT_FAILURE,
          "'arguments' does not match.\nPID: %d\nps arg count: %ld\nprocstat arg count: %ld",
          ps_state.process_id, ps_state.arguments.size(), procstat_state.arguments.size());
+
+    if(!procstat(ps_state.process_id, procstat_sample)) // exited
+      continue;
+
+    flaw(ps_state.process_id != procstat_sample.process_id ||
+         ps_state.parent_process_id != procstat_sample.parent_process_id ||
+         ps_state.process_group_id != procstat_sample.process_group_id ||
+         ps_state.nice_value != procstat_sample.nice_value ||
+         procstat_state.session_id != procstat_sample.session_id,
+         terminal::critical,system(tmp_buffer1),EXIT_FAILURE,
+         "sample does not match.\nPID: %d\nps parent PID: %d\nsample parent PID: %d",
+         ps_state.process_id, ps_state.parent_process_id, procstat_sample.parent_process_id)
   }
   posix::fclose(fptr);
 
   if(field_buffer != NULL)
     posix::free(field_buffer);
 
+  flaw(!procstat_bench(),
+       terminal::critical,,EXIT_FAILURE,
+       "unable to sample this process: %s", posix::strerror(errno))
+
   posix::printf("TEST PASSED!\n");
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,108 @@
+// POSIX
+#include <time.h>
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/rpc.h>
+#include <put/application.h>
+
+enum : uint32_t {
+  Requests = 200000,
+  Window = 64, // requests pipelined on the connection
+};
+
+static const char* const socket_path = "/tmp/put_rpc_bench.socket";
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+struct LoadGenerator
+{
+  LoadGenerator(RpcClient& c) noexcept
+    : client(c), sent(0), completed(0), failed(0), latencies(Requests) { }
+
+  void send(void) noexcept
+  {
+    uint32_t number = sent++;
+    vfifo request(64);
+    request << number;
+    uint64_t start = now();
+    client.call(request,
+                [this, number, start](bool ok, vfifo& reply) noexcept
+                {
+                  uint32_t echo = ~number;
+                  reply >> echo;
+                  if(!ok || echo != number)
+                    ++failed;
+                  latencies[completed++] = now() - start;
+                  if(sent < Requests)
+                    send();
+                });
+  }
+
+  RpcClient& client;
+  uint32_t sent;
+  uint32_t completed;
+  uint32_t failed;
+  std::vector<uint64_t> latencies;
+};
+
+int main(int, char* [])
+{
+  Application app;
+  ::unlink(socket_path);
+
+  RpcServer server(EDomain::local, EType::stream, EProtocol::unspec, PollEvent::EdgeTriggered);
+  flaw(!server.bind(socket_path),
+       terminal::critical,,EXIT_FAILURE,
+       "unable to bind server socket")
+
+  bool connected = false;
+  Object::connect(server.newPeerRequest,
+                  [&server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server.acceptPeerRequest(socket); });
+  Object::connect(server.connectedPeer, [&connected](posix::fd_t) noexcept { connected = true; });
+  Object::connect(server.request,
+                  [&server](posix::fd_t socket, uint32_t id, vfifo request) noexcept
+                  {
+                    server.reply(socket, id, request); // echo
+                  });
+
+  RpcClient client(EDomain::local, EType::stream, EProtocol::unspec, PollEvent::EdgeTriggered);
+  flaw(!client.connect(socket_path),
+       terminal::critical,,EXIT_FAILURE,
+       "unable to connect to server socket")
+  while(!connected)
+    Application::processQueue();
+
+  LoadGenerator generator(client);
+  uint64_t elapsed = now();
+  for(uint32_t i = 0; i < Window; ++i)
+    generator.send();
+  while(generator.completed < Requests)
+    Application::processQueue();
+  elapsed = now() - elapsed;
+  ::unlink(socket_path);
+
+  std::sort(generator.latencies.begin(), generator.latencies.end());
+  posix::printf("%u requests, %u pipelined: %10.0f requests/s, p50 %7.1f us, p99 %7.1f us\n",
+                uint32_t(Requests), uint32_t(Window),
+                double(Requests) / (double(elapsed) / 1000000000),
+                double(generator.latencies[Requests / 2]) / 1000,
+                double(generator.latencies[Requests - Requests / 100]) / 1000);
+
+  flaw(generator.failed,
+       terminal::critical,,EXIT_FAILURE,
+       "%u requests failed", generator.failed)
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+// POSIX
+#include <time.h>
+#include <inttypes.h>
+
+// STL
+#include <atomic>
+#include <new>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/object.h>
+#include <put/application.h>
+
+enum : uint32_t {
+  Emissions = 100000,
+  Batch = 1000, // emissions queued before the event loop runs them
+};
+
+static std::atomic<uint64_t> s_allocations(0);
+
+void* operator new(std::size_t size)
+{
+  ++s_allocations;
+  return posix::malloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+  { posix::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept
+  { posix::free(ptr); }
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+struct Receiver : Object
+{
+  void slot(int a, int b) noexcept { total += uint64_t(a + b); ++calls; }
+  static uint64_t total;
+  static uint64_t calls;
+};
+
+uint64_t Receiver::total = 0;
+uint64_t Receiver::calls = 0;
+
+static bool bench(uint32_t connections) noexcept
+{
+  Object::signal<int, int> sig;
+  Receiver* receivers = new Receiver[connections];
+  for(uint32_t i = 0; i < connections; ++i)
+    Object::connect(sig, &receivers[i], &Receiver::slot);
+
+  uint64_t emit_time = 0;
+  uint64_t dispatch_time = 0;
+  uint64_t allocations = s_allocations;
+  Receiver::calls = 0;
+
+  for(uint32_t done = 0; done < Emissions; done += Batch)
+  {
+    uint64_t start = now();
+    for(uint32_t i = 0; i < Batch; ++i)
+      flaw(!Object::enqueue_copy(sig, int(i), int(i)),
+           terminal::critical,,false,
+           "signal emission failed")
+    uint64_t middle = now();
+    uint64_t expected = uint64_t(done + Batch) * connections;
+    while(Receiver::calls < expected)
+      Application::processQueue();
+    emit_time += middle - start;
+    dispatch_time += now() - middle;
+  }
+  allocations = s_allocations - allocations;
+
+  posix::printf("%2u connections: %7.1f ns/emission %6.1f ns/slot call %8.3f allocations/emission\n",
+                connections,
+                double(emit_time) / Emissions,
+                double(dispatch_time) / (uint64_t(Emissions) * connections),
+                double(allocations) / Emissions);
+
+  delete[] receivers;
+  return Receiver::calls == uint64_t(Emissions) * connections;
+}
+
+// direct slots too large to be stored inline must be called without being copied
+static bool direct(void) noexcept
+{
+  Object::signal<int, int> sig;
+  uint64_t pad[4] = { 1, 2, 3, 4 }; // pushes the lambda past SLOT_STORAGE_SIZE
+  uint64_t calls = 0;
+  uint64_t grown = 0;
+
+  Object::connect(sig,
+                  [pad, &calls, &sig, &grown](int, int) noexcept
+                  {
+                    if(!calls++) // grow the slot list while this slot is executing
+                      for(int i = 0; i < SIGNAL_INLINE_SLOTS * 2; ++i)
+                        Object::connect(sig, [&grown](int, int) noexcept { ++grown; }, Object::DirectConnection);
+                  }, Object::DirectConnection);
+
+  flaw(!Object::enqueue_copy(sig, 0, 0),
+       terminal::critical,,false,
+       "signal emission failed")
+
+  uint64_t allocations = s_allocations;
+  for(uint32_t i = 0; i < Emissions; ++i)
+    Object::enqueue_copy(sig, 0, 0);
+  allocations = s_allocations - allocations;
+
+  posix::printf("direct heap slot: %8.3f allocations/emission\n",
+                double(allocations) / Emissions);
+  return calls == uint64_t(Emissions) + 1 &&
+         grown == uint64_t(Emissions) * SIGNAL_INLINE_SLOTS * 2 &&
+         pad[3] == 4 &&
+         allocations == 0;
+}
+
+struct Emitter : Object
+{
+  signal<int> fired;
+};
+
+// a direct slot may delete the object that emits the signal
+static bool deleted_emitter(void) noexcept
+{
+  Emitter* emitter = new Emitter;
+  uint32_t calls = 0;
+  Object::connect(emitter->fired,
+                  [&emitter, &calls](int) noexcept
+                  {
+                    ++calls;
+                    delete emitter;
+                    emitter = nullptr;
+                  }, Object::DirectConnection);
+  Object::connect(emitter->fired, [&calls](int) noexcept { ++calls; }, Object::DirectConnection); // destroyed with the emitter
+
+  Object::enqueue_copy(emitter->fired, 0);
+  Application::processQueue(); // frees the emitter
+  return calls == 1 && emitter == nullptr;
+}
+
+int main(int, char* [])
+{
+  Application app;
+  flaw(!bench(1) || !bench(4) || !bench(64),
+       terminal::critical,,EXIT_FAILURE,
+       "slot calls missing")
+  flaw(!direct(),
+       terminal::critical,,EXIT_FAILURE,
+       "direct slot was copied or missed")
+  flaw(!deleted_emitter(),
+       terminal::critical,,EXIT_FAILURE,
+       "slots of a deleted emitter were called")
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,454 @@
+// POSIX
+#include <unistd.h>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/socket.h>
+#include <put/application.h>
+
+enum : posix::ssize_t {
+  FrameBytes = 100 * 1024,
+  Frames = 40, // far more than the socket buffer holds
+  HighWater = 256 * 1024,
+  Datagrams = 100, // several recvmmsg()/sendmmsg() batches
+  RingBytes = 64 * 1024,
+  RingMessageBytes = 12 * 1024, // doesn't divide the ring so messages wrap around
+  RingMessages = RingBytes / RingMessageBytes, // messages that fit in the ring
+  Echoes = 100,
+  Backlog = 4, // connections that fill a listener's queue
+};
+
+enum : milliseconds_t {
+  AsyncTimeout = 200,
+};
+
+static const char* const socket_path = "/tmp/put_socket_test.socket";
+static const char* const datagram_path = "/tmp/put_socket_test.datagram";
+
+// a blocking client socket must not block the event loop when the peer falls behind
+static bool backpressure(void) noexcept
+{
+  ::unlink(socket_path);
+  ServerSocket* server = new ServerSocket; // freed after its queued calls (a stack object could be replaced by the next test's)
+  flaw(!server->bind(socket_path),
+       terminal::critical,,false,
+       "unable to bind server socket")
+
+  bool connected = false;
+  posix::ssize_t received = 0;
+  posix::ssize_t corrupt = 0;
+  Object::connect(server->newPeerRequest,
+                  [server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server->acceptPeerRequest(socket); });
+  Object::connect(server->connectedPeer, [&connected](posix::fd_t) noexcept { connected = true; });
+  Object::connect(server->newPeerMessage,
+                  [&received, &corrupt](posix::fd_t, vfifo message, posix::fd_t) noexcept
+                  {
+                    bool intact = message.size() == FrameBytes;
+                    for(posix::ssize_t i = 0; intact && i < message.size(); ++i)
+                      intact = message.data<uint8_t>()[i] == uint8_t(received);
+                    if(!intact)
+                      ++corrupt;
+                    ++received;
+                  });
+
+  ClientSocket* client = new ClientSocket; // blocking
+  posix::size_t high = 0;
+  posix::size_t low = 0;
+  Object::connect(client->highWater, [&high](posix::fd_t, posix::size_t) noexcept { ++high; });
+  Object::connect(client->lowWater, [&low](posix::fd_t) noexcept { ++low; });
+  client->setHighWaterMark(HighWater);
+
+  flaw(!client->connect(socket_path),
+       terminal::critical,,false,
+       "unable to connect to server socket")
+  while(!connected)
+    Application::processQueue();
+
+  for(posix::ssize_t frame = 0; frame < Frames; ++frame)
+  {
+    vfifo message(FrameBytes);
+    posix::memset(message.dataEnd(), int(frame), posix::size_t(FrameBytes));
+    message.produce(FrameBytes);
+    flaw(!client->write(message),
+         terminal::critical,,false,
+         "unable to queue frame %li", frame)
+  }
+
+  while(received < Frames || low < 1)
+    Application::processQueue();
+  delete client;
+  delete server;
+
+  flaw(high != 1 || low != 1,
+       terminal::critical,,false,
+       "highWater fired %lu times and lowWater fired %lu times", high, low)
+  return !corrupt;
+}
+
+// a OneShot server and the peers it accepts keep reporting after their first activation
+static bool oneshot(void) noexcept
+{
+  ::unlink(socket_path);
+  ServerSocket* server = new ServerSocket(EDomain::local, EType::stream, EProtocol::unspec, PollEvent::OneShot);
+  flaw(!server->bind(socket_path),
+       terminal::critical,,false,
+       "unable to bind server socket")
+
+  posix::size_t connected = 0;
+  posix::size_t received = 0;
+  Object::connect(server->newPeerRequest,
+                  [server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server->acceptPeerRequest(socket); });
+  Object::connect(server->connectedPeer, [&connected](posix::fd_t) noexcept { ++connected; });
+  Object::connect(server->newPeerMessage,
+                  [&received](posix::fd_t, vfifo, posix::fd_t) noexcept { ++received; });
+
+  ClientSocket* first = new ClientSocket;
+  ClientSocket* second = new ClientSocket;
+  flaw(!first->connect(socket_path),
+       terminal::critical,,false,
+       "unable to connect to server socket")
+  while(connected < 1)
+    Application::processQueue();
+  flaw(!second->connect(socket_path),
+       terminal::critical,,false,
+       "unable to connect to server socket twice")
+  while(connected < 2)
+    Application::processQueue();
+
+  vfifo message(16);
+  message.produce(16);
+  first->write(message);
+  while(received < 1)
+    Application::processQueue();
+  first->write(message);
+  while(received < 2)
+    Application::processQueue();
+
+  delete first;
+  delete second;
+  delete server;
+  return true;
+}
+
+// datagrams written together are sent and received in batches without being lost or reordered
+static bool datagrams(void) noexcept
+{
+  ::unlink(datagram_path);
+  DatagramSocket* receiver = new DatagramSocket;
+  flaw(!receiver->bind(datagram_path),
+       terminal::critical,,false,
+       "unable to bind datagram socket")
+
+  uint32_t received = 0;
+  uint32_t misordered = 0;
+  Object::connect(receiver->newMessage,
+                  [&received, &misordered](posix::fd_t, vfifo message, posix::sockaddr_t) noexcept
+                  {
+                    uint32_t number = ~received;
+                    message >> number;
+                    if(message.hadError() || number != received)
+                      ++misordered;
+                    ++received;
+                  });
+
+  posix::sockaddr_t peer;
+  peer = datagram_path;
+  peer = EDomain::local;
+
+  DatagramSocket* sender = new DatagramSocket;
+  for(uint32_t number = 0; number < Datagrams; ++number)
+  {
+    vfifo message(64);
+    message << number;
+    flaw(!sender->write(message, peer),
+         terminal::critical,,false,
+         "unable to queue datagram %u", number)
+  }
+
+  while(received < Datagrams)
+    Application::processQueue();
+  delete sender;
+  delete receiver;
+  return !misordered;
+}
+
+// large messages go through the shared ring until it's full and the peer's credits make room again
+static bool shared_ring(void) noexcept
+{
+  ::unlink(socket_path);
+  ServerSocket* server = new ServerSocket;
+  flaw(!server->bind(socket_path),
+       terminal::critical,,false,
+       "unable to bind server socket")
+
+  bool connected = false;
+  posix::ssize_t received = 0;
+  posix::ssize_t corrupt = 0;
+  Object::connect(server->newPeerRequest,
+                  [server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server->acceptPeerRequest(socket); });
+  Object::connect(server->connectedPeer, [&connected](posix::fd_t) noexcept { connected = true; });
+  Object::connect(server->newPeerMessage,
+                  [server, &received, &corrupt](posix::fd_t socket, vfifo message, posix::fd_t) noexcept
+                  {
+                    if(message.size() != RingMessageBytes) // ping: the reply follows any credit
+                    {
+                      server->write(socket, message);
+                      return;
+                    }
+                    for(posix::ssize_t i = 0; i < message.size(); ++i)
+                      if(message.data<uint8_t>()[i] != uint8_t(received + i))
+                      {
+                        ++corrupt;
+                        break;
+                      }
+                    ++received;
+                  });
+
+  ClientSocket* client = new ClientSocket;
+  const ClientSocket* sender = client;
+  bool pong = false;
+  Object::connect(client->newMessage, [&pong](posix::fd_t, vfifo, posix::fd_t) noexcept { pong = true; });
+
+  flaw(!client->connect(socket_path),
+       terminal::critical,,false,
+       "unable to connect to server socket")
+  while(!connected)
+    Application::processQueue();
+  flaw(!client->shareMemory(RingBytes),
+       terminal::critical,,false,
+       "unable to share memory")
+
+  posix::ssize_t sent = 0;
+  auto send = [client, sender, &sent](void) noexcept -> bool // returns true if the message went through the ring
+  {
+    vfifo message(RingMessageBytes);
+    for(posix::ssize_t i = 0; i < RingMessageBytes; ++i)
+      message.dataEnd<uint8_t>()[i] = uint8_t(sent + i);
+    message.produce(RingMessageBytes);
+    ++sent;
+    posix::size_t before = sender->queued();
+    return client->write(message) &&
+           sender->queued() - before == ClientSocket::FrameHeaderSize; // only the header is sent on the socket
+  };
+
+  posix::ssize_t ring = 0;
+  for(posix::ssize_t i = 0; i < RingMessages * 2; ++i) // fills the ring and falls back to the socket
+    if(send())
+      ++ring;
+  flaw(ring != RingMessages,
+       terminal::critical,,false,
+       "%li of %li messages went through the shared ring", ring, posix::ssize_t(RingMessages * 2))
+  while(received < sent)
+    Application::processQueue();
+
+  vfifo ping(16);
+  ping << uint32_t(0);
+  client->write(ping);
+  while(!pong)
+    Application::processQueue();
+
+  ring = 0;
+  for(posix::ssize_t i = 0; i < RingMessages; ++i) // wraps around the end of the ring
+    if(send())
+      ++ring;
+  flaw(ring != RingMessages,
+       terminal::critical,,false,
+       "credits only made room for %li of %li messages", ring, posix::ssize_t(RingMessages))
+  while(received < sent)
+    Application::processQueue();
+  delete client;
+  delete server;
+  return !corrupt;
+}
+
+// bound port of a TCP socket
+static in_port_t bound_port(posix::fd_t socket) noexcept
+{
+  sockaddr_in addr;
+  socklen_t length = sizeof(addr);
+  if(::getsockname(socket, reinterpret_cast<sockaddr*>(&addr), &length) != posix::success_response)
+    return 0;
+  return ntohs(addr.sin_port);
+}
+
+// messages of every size are echoed over a loopback TCP connection
+static bool tcp_loopback(void) noexcept
+{
+  ServerSocket* server = new ServerSocket(EDomain::inet);
+  server->setNoDelay();
+  flaw(!server->bind("127.0.0.1", 0),
+       terminal::critical,,false,
+       "unable to bind TCP server socket")
+
+  bool connected = false;
+  Object::connect(server->newPeerRequest,
+                  [server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server->acceptPeerRequest(socket); });
+  Object::connect(server->connectedPeer, [&connected](posix::fd_t) noexcept { connected = true; });
+  Object::connect(server->newPeerMessage,
+                  [server](posix::fd_t socket, vfifo message, posix::fd_t) noexcept
+                    { server->write(socket, message); });
+
+  ClientSocket* client = new ClientSocket(EDomain::inet, EType::stream, EProtocol::unspec, PollEvent::EdgeTriggered); // messages written while connecting are sent once connected
+  uint32_t received = 0;
+  uint32_t mismatched = 0;
+  Object::connect(client->newMessage,
+                  [&received, &mismatched](posix::fd_t, vfifo message, posix::fd_t) noexcept
+                  {
+                    bool intact = message.size() == posix::ssize_t(received * 997);
+                    for(posix::ssize_t i = 0; intact && i < message.size(); ++i)
+                      intact = message.data<uint8_t>()[i] == uint8_t(received + i);
+                    if(!intact)
+                      ++mismatched;
+                    ++received;
+                  });
+
+  client->setNoDelay();
+  flaw(!client->connect("127.0.0.1", bound_port(server->fd())),
+       terminal::critical,,false,
+       "unable to connect to TCP server socket")
+  while(!connected)
+    Application::processQueue();
+
+  for(uint32_t number = 0; number < Echoes; ++number)
+  {
+    vfifo message(number * 997);
+    for(posix::ssize_t i = 0; i < posix::ssize_t(number * 997); ++i)
+      message.dataEnd<uint8_t>()[i] = uint8_t(number + i);
+    message.produce(number * 997);
+    client->write(message);
+  }
+
+  while(received < Echoes)
+    Application::processQueue();
+  delete client;
+  delete server;
+  return !mismatched;
+}
+
+// connectAsync() reports how the connection attempt ended: connected, refused or timed out
+static bool connect_async(posix::error_t& refused, posix::error_t& timed_out) noexcept
+{
+  ServerSocket* server = new ServerSocket(EDomain::inet);
+  flaw(!server->bind("127.0.0.1", 0),
+       terminal::critical,,false,
+       "unable to bind TCP server socket")
+
+  bool accepted = false;
+  Object::connect(server->newPeerRequest,
+                  [server](posix::fd_t socket, posix::sockaddr_t, proccred_t) noexcept
+                    { server->acceptPeerRequest(socket); });
+  Object::connect(server->connectedPeer, [&accepted](posix::fd_t) noexcept { accepted = true; });
+
+  posix::sockaddr_t peer;
+  peer.setAddress("127.0.0.1", bound_port(server->fd()));
+
+  bool connected = false;
+  ClientSocket* client = new ClientSocket(EDomain::inet);
+  Object::connect(client->connected, [&connected](posix::fd_t, posix::sockaddr_t, proccred_t) noexcept { connected = true; });
+  flaw(!client->connectAsync(peer, AsyncTimeout),
+       terminal::critical,,false,
+       "unable to start connecting: %s", posix::strerror(errno))
+  while(!connected || !accepted)
+    Application::processQueue();
+  delete client;
+  delete server;
+
+  // a bound port that nothing listens on
+  posix::fd_t unused = ::socket(AF_INET, SOCK_STREAM, 0);
+  posix::sockaddr_t address;
+  address.setAddress("127.0.0.1", 0);
+  flaw(unused == posix::invalid_descriptor ||
+       !posix::bind(unused, address, socklen_t(address.size())),
+       terminal::critical,,false,
+       "unable to bind: %s", posix::strerror(errno))
+  peer.setAddress("127.0.0.1", bound_port(unused));
+
+  posix::error_t error = posix::success_response;
+  bool disconnected = false;
+  client = new ClientSocket(EDomain::inet);
+  Object::connect(client->connectFailed, [&error](posix::fd_t, posix::error_t e) noexcept { error = e; });
+  Object::connect(client->disconnected, [&disconnected](posix::fd_t) noexcept { disconnected = true; });
+  if(client->connectAsync(peer, AsyncTimeout))
+    while(!disconnected)
+      Application::processQueue();
+  refused = error;
+  delete client;
+  posix::close(unused);
+
+  // a listener that never accepts drops handshakes once its queue is full
+  posix::fd_t listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  flaw(listener == posix::invalid_descriptor ||
+       !posix::bind(listener, address, socklen_t(address.size())) ||
+       !posix::listen(listener, 0),
+       terminal::critical,,false,
+       "unable to listen: %s", posix::strerror(errno))
+  peer.setAddress("127.0.0.1", bound_port(listener));
+
+  posix::fd_t fillers[Backlog];
+  for(posix::fd_t& filler : fillers)
+  {
+    filler = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    posix::connect(filler, peer, socklen_t(peer.size()));
+  }
+  ::usleep(100000); // handshakes complete until the queue is full
+
+  error = posix::success_response;
+  disconnected = false;
+  client = new ClientSocket(EDomain::inet);
+  Object::connect(client->connectFailed, [&error](posix::fd_t, posix::error_t e) noexcept { error = e; });
+  Object::connect(client->disconnected, [&disconnected](posix::fd_t) noexcept { disconnected = true; });
+  if(client->connectAsync(peer, AsyncTimeout))
+    while(!disconnected)
+      Application::processQueue();
+  timed_out = error;
+  delete client;
+
+  // connect() to a TCP address returns without waiting for the handshake
+  client = new ClientSocket(EDomain::inet);
+  flaw(!client->connect("127.0.0.1", bound_port(listener)) ||
+       !client->isConnecting(),
+       terminal::critical,,false,
+       "connect() waited for the handshake")
+  delete client;
+
+  for(posix::fd_t filler : fillers)
+    posix::close(filler);
+  posix::close(listener);
+  return true;
+}
+
+int main(int, char* [])
+{
+  Application app;
+  ::alarm(30); // a blocked event loop fails instead of hanging
+  flaw(!backpressure(),
+       terminal::critical,,EXIT_FAILURE,
+       "frames were lost or the water marks were not reported")
+  flaw(!oneshot(),
+       terminal::critical,,EXIT_FAILURE,
+       "OneShot sockets stopped reporting")
+  flaw(!datagrams(),
+       terminal::critical,,EXIT_FAILURE,
+       "datagrams were reordered")
+  flaw(!shared_ring(),
+       terminal::critical,,EXIT_FAILURE,
+       "messages sent through shared memory were corrupted")
+  flaw(!tcp_loopback(),
+       terminal::critical,,EXIT_FAILURE,
+       "TCP messages were not echoed intact")
+
+  posix::error_t refused = posix::success_response;
+  posix::error_t timed_out = posix::success_response;
+  flaw(!connect_async(refused, timed_out) ||
+       refused != posix::error_t(posix::errc::connection_refused) ||
+       timed_out != posix::error_t(posix::errc::timed_out),
+       terminal::critical,,EXIT_FAILURE,
+       "connectAsync() failures were reported as \"%s\" and \"%s\"", posix::strerror(refused), posix::strerror(timed_out))
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+// POSIX
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/cxxutils/vfifo.h>
+
+enum : posix::size_t {
+  Rounds = 200,
+  VectorBytes = 1024 * 1024, // size of each vector
+  MapEntries = 10000,
+  LongString = 100000, // longer than a 16-bit length allows
+};
+
+static uint64_t now(void) noexcept
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+template<typename T>
+static bool bench(const char* name, const T& value, posix::size_t bytes) noexcept
+{
+  vfifo buffer(0);
+  T result;
+  uint64_t write_time = 0;
+  uint64_t read_time = 0;
+  bool ok = true;
+
+  for(posix::size_t round = 0; ok && round < Rounds; ++round)
+  {
+    uint64_t start = now();
+    buffer << value;
+    uint64_t middle = now();
+    buffer >> result;
+    uint64_t end = now();
+    write_time += middle - start;
+    read_time += end - middle;
+    ok = !buffer.hadError() && buffer.empty() && result == value;
+  }
+
+  posix::printf("%-16s %9.1f MiB/s serialize %9.1f MiB/s deserialize\n",
+                name,
+                double(bytes) * Rounds / 1024 / 1024 / (double(write_time) / 1000000000),
+                double(bytes) * Rounds / 1024 / 1024 / (double(read_time) / 1000000000));
+  return ok;
+}
+
+// bools are scalars but a vector of them is serialized element by element
+static bool bools(void) noexcept
+{
+  vfifo buffer(64);
+  std::vector<bool> flags = { true, false, false, true, true };
+  std::vector<bool> flags_result;
+  bool first = false;
+  bool second = true;
+  buffer << true << false << flags;
+  buffer >> first >> second >> flags_result;
+  return !buffer.hadError() && buffer.empty() &&
+         first && !second && flags_result == flags;
+}
+
+// ring storage maps the same pages twice so data that wraps around stays contiguous
+static bool ring_wraparound(void) noexcept
+{
+  vfifo ring(::sysconf(_SC_PAGESIZE), vfifo::Ring);
+  posix::ssize_t capacity = ring.capacity();
+  uint8_t pattern[64];
+  for(posix::size_t i = 0; i < sizeof(pattern); ++i)
+    pattern[i] = uint8_t(i + 1);
+
+  if(!ring.ring() ||
+     !ring.produce(capacity - 16) ||
+     !ring.consume(capacity - 16) ||
+     ring.writable().iov_len != posix::size_t(capacity))
+    return false;
+
+  posix::memcpy(ring.writable().iov_base, pattern, sizeof(pattern)); // crosses into the second mapping
+  ring.produce(sizeof(pattern));
+  if(posix::memcmp(ring.data(), pattern, sizeof(pattern)) ||
+     posix::memcmp(ring.begin(), pattern + 16, sizeof(pattern) - 16)) // the same bytes seen through the first mapping
+    return false;
+
+  ring.consume(sizeof(pattern)); // drained() moves the read position back to the first mapping
+  return ring.empty() &&
+         ring.discarded() == posix::ssize_t(sizeof(pattern)) - 16 &&
+         ring.unused() == capacity;
+}
+
+// free space of a shared ring aliases bytes that copies may still read
+static bool ring_copy_on_write(void) noexcept
+{
+  vfifo ring(::sysconf(_SC_PAGESIZE), vfifo::Ring);
+  posix::memset(ring.writable().iov_base, 'a', 100);
+  ring.produce(100);
+
+  vfifo copy(ring);
+  ring.consume(100);
+  if(!ring.shared())
+    return false;
+
+  iovec space = ring.writable(); // moves to new storage
+  if(space.iov_base == NULL ||
+     ring.shared() ||
+     copy.shared() ||
+     ring.begin() == copy.begin())
+    return false;
+  posix::memset(space.iov_base, 'b', space.iov_len);
+  ring.produce(posix::ssize_t(space.iov_len));
+
+  for(posix::ssize_t i = 0; i < copy.size(); ++i)
+    if(copy.data()[i] != 'a')
+      return false;
+  return copy.size() == 100;
+}
+
+// SharedRing storage attached through its descriptor is the same memory
+static bool shared_ring(void) noexcept
+{
+  vfifo writer(::sysconf(_SC_PAGESIZE), vfifo::SharedRing);
+  vfifo reader(0);
+  if(writer.descriptor() == posix::invalid_descriptor ||
+     !reader.attach(::dup(writer.descriptor()), writer.capacity()) ||
+     reader.capacity() != writer.capacity())
+    return false;
+
+  posix::ssize_t offset = writer.capacity() - 8;
+  writer.produce(offset);
+  writer.consume(offset);
+  posix::memcpy(writer.writable().iov_base, "wrapped around", 15);
+  writer.produce(15);
+
+  reader.produce(offset);
+  reader.consume(offset);
+  reader.produce(15);
+  return !posix::strcmp(reader.data(), "wrapped around");
+}
+
+// storage that could be resized under the mappings is refused
+static bool unsealed_ring(void) noexcept
+{
+  posix::ssize_t page = ::sysconf(_SC_PAGESIZE);
+  vfifo writer(page, vfifo::SharedRing);
+  vfifo reader(0);
+  if(writer.descriptor() == posix::invalid_descriptor ||
+     reader.attach(::dup(writer.descriptor()), writer.capacity() * 2)) // not the size the peer claims
+    return false;
+#if defined(__linux__) && defined(SYS_memfd_create)
+  posix::fd_t fd = posix::fd_t(::syscall(SYS_memfd_create, "unsealed", 0));
+  if(fd == posix::invalid_descriptor ||
+     ::ftruncate(fd, page) != posix::success_response)
+    return false;
+  if(reader.attach(fd, page)) // the peer could still ftruncate() it
+    return false;
+#endif
+  return !reader.ring() &&
+         reader.attach(::dup(writer.descriptor()), writer.capacity());
+}
+
+int main(int, char* [])
+{
+  std::vector<uint8_t> bytes(VectorBytes);
+  std::vector<double> doubles(VectorBytes / sizeof(double));
+  std::map<std::string, std::string> strings;
+  std::string text(LongString, 'x');
+  posix::size_t string_bytes = 0;
+
+  for(posix::size_t i = 0; i < bytes.size(); ++i)
+    bytes[i] = uint8_t(i * 7);
+  for(posix::size_t i = 0; i < doubles.size(); ++i)
+    doubles[i] = double(i) / 3;
+  for(posix::size_t i = 0; i < MapEntries; ++i)
+  {
+    std::string key = "key" + std::to_string(i);
+    std::string value = "value" + std::to_string(i * 31);
+    string_bytes += key.size() + value.size();
+    strings.emplace(key, value);
+  }
+
+  flaw(!bench("vector<uint8_t>", bytes, VectorBytes) ||
+       !bench("vector<double>", doubles, VectorBytes) ||
+       !bench("map<string>", strings, string_bytes) ||
+       !bench("string", text, LongString),
+       terminal::critical,,EXIT_FAILURE,
+       "deserialized data does not match")
+  flaw(!bools(),
+       terminal::critical,,EXIT_FAILURE,
+       "deserialized bools do not match")
+  flaw(!ring_wraparound(),
+       terminal::critical,,EXIT_FAILURE,
+       "ring data does not wrap around")
+  flaw(!ring_copy_on_write(),
+       terminal::critical,,EXIT_FAILURE,
+       "writing to a shared ring modified a copy")
+  flaw(!shared_ring(),
+       terminal::critical,,EXIT_FAILURE,
+       "attached ring does not share memory")
+  flaw(!unsealed_ring(),
+       terminal::critical,,EXIT_FAILURE,
+       "resizable shared memory was attached")
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}
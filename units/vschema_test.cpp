@@ -0,0 +1,149 @@
+// STL
+#include <string>
+#include <vector>
+
+// PUT
+#include <put/cxxutils/posix_helpers.h>
+#include <put/cxxutils/vterm.h>
+#include <put/cxxutils/vschema.h>
+
+enum : posix::size_t {
+  LongString = 100000, // longer than a 16-bit length allows
+};
+
+struct message_t
+{
+  uint32_t id;
+  std::string name;
+  std::vector<double> values;
+  std::vector<std::string> tags;
+  std::vector<std::vector<std::vector<uint16_t>>> tables; // nested containers
+  double ratio;
+};
+
+typedef vschema<message_t,
+                VFIELD(message_t, id),
+                VFIELD(message_t, name),
+                VFIELD(message_t, values),
+                VFIELD(message_t, tags),
+                VFIELD(message_t, tables),
+                VFIELD(message_t, ratio)> message_schema;
+
+struct other_t
+{
+  uint32_t id;
+  std::string name;
+};
+
+typedef vschema<other_t,
+                VFIELD(other_t, id),
+                VFIELD(other_t, name)> other_schema;
+
+template<typename T>
+struct wrapper_t
+{
+  T value;
+};
+
+template<typename T>
+using wrapper_schema = vschema<wrapper_t<T>, VFIELD(wrapper_t<T>, value)>;
+
+typedef std::vector<int32_t> ints;
+typedef std::vector<std::string> strings;
+
+static bool operator == (const message_t& a, const message_t& b) noexcept
+{
+  return a.id == b.id &&
+         a.name == b.name &&
+         a.values == b.values &&
+         a.tags == b.tags &&
+         a.tables == b.tables &&
+         a.ratio == b.ratio;
+}
+
+static message_t sample(void) noexcept
+{
+  message_t msg;
+  msg.id = 0xDEADBEEF;
+  msg.name.assign(LongString, 'n');
+  msg.values = { 0.5, 1.25, -3.0 };
+  msg.tags = { "first", "", std::string(LongString, 't') };
+  msg.tables = { { { 1, 2, 3 }, { } }, { }, { { 4 } } };
+  msg.ratio = 0.75;
+  return msg;
+}
+
+// every field survives a round trip, including long arrays and nested containers
+static bool round_trip(void) noexcept
+{
+  vfifo buffer(0);
+  message_t msg = sample();
+  message_t result;
+  return message_schema::encode(buffer, msg) &&
+         buffer.size() == posix::ssize_t(message_schema::frameSize(msg)) &&
+         message_schema::decode(buffer, result) &&
+         buffer.empty() &&
+         result == msg;
+}
+
+// frames that are incomplete, corrupt or of another schema are left in the buffer
+static bool rejected(void) noexcept
+{
+  message_t msg = sample();
+  message_t result;
+  other_t other;
+  vfifo buffer(0);
+  if(!message_schema::encode(buffer, msg))
+    return false;
+
+  vfifo truncated = buffer.view(0, buffer.size() - 1);
+  if(message_schema::decode(truncated, result) ||
+     truncated.size() != buffer.size() - 1 ||
+     other_schema::decode(buffer, other))
+    return false;
+
+  // corrupt the element count of the first table
+  posix::ssize_t tables = posix::ssize_t(message_schema::prefixSize() +
+                                         msg.name.size() +
+                                         msg.values.size() * sizeof(double));
+  for(const std::string& tag : msg.tags)
+    tables += posix::ssize_t(sizeof(uint32_t) + tag.size());
+  uint32_t count;
+  posix::memcpy(&count, buffer.data() + tables, sizeof(uint32_t));
+  if(count != msg.tables.front().size())
+    return false;
+  count = 1000;
+  posix::memcpy(buffer.data() + tables, &count, sizeof(uint32_t));
+  return !message_schema::decode(buffer, result) &&
+         buffer.size() == posix::ssize_t(message_schema::frameSize(msg));
+}
+
+// the depth of nested containers is part of the signature
+static bool nesting(void) noexcept
+{
+  if(wrapper_schema<std::vector<ints>>::signature() == wrapper_schema<std::vector<std::vector<ints>>>::signature() ||
+     wrapper_schema<strings>::signature() == wrapper_schema<std::vector<strings>>::signature() ||
+     wrapper_schema<ints>::signature() == wrapper_schema<std::vector<ints>>::signature())
+    return false;
+
+  vfifo buffer(0);
+  wrapper_t<std::vector<ints>> shallow { { { 1, 2 }, { 3 } } };
+  wrapper_t<std::vector<std::vector<ints>>> deep;
+  return wrapper_schema<std::vector<ints>>::encode(buffer, shallow) &&
+         !wrapper_schema<std::vector<std::vector<ints>>>::decode(buffer, deep);
+}
+
+int main(int, char* [])
+{
+  flaw(!round_trip(),
+       terminal::critical,,EXIT_FAILURE,
+       "decoded message does not match")
+  flaw(!rejected(),
+       terminal::critical,,EXIT_FAILURE,
+       "invalid frame was decoded")
+  flaw(!nesting(),
+       terminal::critical,,EXIT_FAILURE,
+       "schemas of different nesting depths were not told apart")
+  posix::printf("TEST PASSED!\n");
+  return EXIT_SUCCESS;
+}